@@ -0,0 +1,202 @@
+#include "BookManager.h"
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace ob
+{
+
+bool pin_current_thread(int cpu)
+{
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof set, &set) == 0;
+#else
+    (void)cpu;
+    return false;
+#endif
+}
+
+// Commands submitted without a time are stamped by the worker's book on apply
+static int64_t command_time(TimePoint t)
+{
+    return t == kBookTime ? kJournalBookTime : time_to_ns(t);
+}
+
+template <class Book>
+BookManager<Book>::BookManager(size_t n, vector<int> cpus, size_t queue_capacity)
+{
+    for (size_t i = 0; i < max<size_t>(n, 1); ++i)
+    {
+        workers.emplace_back(new Worker(queue_capacity));
+        if (!cpus.empty()) workers.back()->cpu = cpus[i % cpus.size()];
+    }
+}
+
+template <class Book>
+SymbolId BookManager<Book>::add_symbol(Price tick_size, size_t worker)
+{
+    if (worker >= workers.size()) worker = next_worker++ % workers.size();
+    books.emplace_back(new Book(tick_size));
+    owner.push_back(uint32_t(worker));
+    return SymbolId(books.size() - 1);
+}
+
+template <class Book>
+void BookManager<Book>::start()
+{
+    if (running) return;
+    running = true;
+    for (auto &w : workers)
+    {
+        w->stopping.store(false, memory_order_relaxed);
+        Worker *wp = w.get();
+        w->th = thread([this, wp] { run(*wp); });
+    }
+}
+
+template <class Book>
+void BookManager<Book>::stop()
+{
+    if (!running) return;
+    for (auto &w : workers) w->stopping.store(true, memory_order_release);
+    for (auto &w : workers) w->th.join();
+    running = false;
+}
+
+template <class Book>
+void BookManager<Book>::sync()
+{
+    for (auto &w : workers)
+        while (w->done.load(memory_order_acquire) < w->submitted) this_thread::yield();
+}
+
+template <class Book>
+bool BookManager<Book>::add_order(SymbolId s, string_view id, Side side, Price price, uint64_t qty, TimePoint t)
+{
+    if (id.size() > kJournalMaxId) return false;
+    return submit(BookCommand{
+        s, make_journal_record(JournalOp::Add, id, command_time(t), uint8_t(side), 0, price.units, qty)});
+}
+
+template <class Book>
+bool BookManager<Book>::add_and_match(SymbolId s, string_view id, Side side, Price price, uint64_t qty,
+                                      TimePoint t)
+{
+    if (id.size() > kJournalMaxId) return false;
+    return submit(BookCommand{
+        s, make_journal_record(JournalOp::AddMatch, id, command_time(t), uint8_t(side), 0, price.units, qty)});
+}
+
+template <class Book>
+bool BookManager<Book>::amend_order(SymbolId s, string_view id, optional<Price> new_price,
+                                    optional<uint64_t> new_qty, TimePoint t)
+{
+    if (id.size() > kJournalMaxId) return false;
+    uint8_t flags = uint8_t((new_price ? kJournalHasPrice : 0) | (new_qty ? kJournalHasQty : 0));
+    return submit(BookCommand{s, make_journal_record(JournalOp::Amend, id, command_time(t), 0, flags,
+                                                     new_price.value_or(Price()).units, new_qty.value_or(0))});
+}
+
+template <class Book>
+bool BookManager<Book>::remove_order(SymbolId s, string_view id, TimePoint t)
+{
+    if (id.size() > kJournalMaxId) return false;
+    return submit(BookCommand{s, make_journal_record(JournalOp::Remove, id, command_time(t))});
+}
+
+template <class Book>
+bool BookManager<Book>::submit(const BookCommand &cmd)
+{
+    return submit(&cmd, 1) == 1;
+}
+
+template <class Book>
+size_t BookManager<Book>::submit(const BookCommand *cmds, size_t n)
+{
+    // each run of commands for the same worker is pushed (and published) as one block
+    size_t queued = 0;
+    for (size_t i = 0; i < n;)
+    {
+        if (cmds[i].symbol >= books.size())
+        {
+            ++i;
+            continue;
+        }
+        uint32_t wi = owner[cmds[i].symbol];
+        size_t end = i + 1;
+        while (end < n && cmds[end].symbol < books.size() && owner[cmds[end].symbol] == wi) ++end;
+        Worker &w = *workers[wi];
+        w.submitted += end - i;
+        queued += end - i;
+        while (i < end)
+        {
+            size_t pushed = w.inbox.try_push(cmds + i, end - i);
+            i += pushed;
+            if (!pushed) this_thread::yield(); // inbox full: wait for the worker
+        }
+    }
+    return queued;
+}
+
+template <class Book>
+typename BookManager<Book>::Stats BookManager<Book>::stats() const
+{
+    Stats st;
+    for (auto &w : workers)
+    {
+        st.applied += w->applied.load(memory_order_relaxed);
+        st.rejected += w->rejected.load(memory_order_relaxed);
+    }
+    return st;
+}
+
+// Worker loop: poll the inbox and apply whatever is queued in place, in batches of at
+// most kDrainBatch so done/stats advance steadily under sustained load
+template <class Book>
+void BookManager<Book>::run(Worker &w)
+{
+    constexpr size_t kDrainBatch = 256;
+    if (w.cpu >= 0) pin_current_thread(w.cpu);
+    vector<Fill> fills;
+    unsigned idle = 0;
+    for (;;)
+    {
+        uint64_t ok = 0;
+        size_t n = w.inbox.drain(
+            [&](const BookCommand *cmds, size_t k) {
+                for (size_t i = 0; i < k; ++i)
+                {
+                    const BookCommand &cmd = cmds[i];
+                    if (books[cmd.symbol]->apply(cmd.op, fills))
+                    {
+                        ++ok;
+                        if (cmd.op.op == JournalOp::AddMatch && !fills.empty() && fill_handler)
+                            fill_handler(cmd.symbol, fills);
+                    }
+                }
+            },
+            kDrainBatch);
+        if (n)
+        {
+            w.applied.fetch_add(ok, memory_order_relaxed);
+            w.rejected.fetch_add(n - ok, memory_order_relaxed);
+            w.done.fetch_add(n, memory_order_release);
+            idle = 0;
+            continue;
+        }
+        if (w.stopping.load(memory_order_acquire) && w.inbox.empty()) return; // stopping and drained
+        // spin briefly, then give the cpu away between polls
+        if (++idle < 64) continue;
+        this_thread::yield();
+    }
+}
+
+template class BookManager<OrderBook>;
+template class BookManager<LadderOrderBook>;
+
+} // namespace ob
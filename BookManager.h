@@ -0,0 +1,118 @@
+#pragma once
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "OrderBook.h"
+#include "SpscRing.h"
+
+namespace ob
+{
+
+// Dense per-manager instrument number, assigned by add_symbol()
+using SymbolId = uint32_t;
+
+// One operation routed to a symbol's book. The operation is carried in journal-record
+// form (fixed size, id inline) so commands queue without allocation and are applied
+// with BasicOrderBook::apply.
+struct BookCommand {
+    SymbolId symbol;
+    JournalRecord op;
+};
+
+// Owns many books and shards them across worker threads. Every book belongs to exactly
+// one worker, which is the only thread that ever touches it, so books need no locks.
+// Each worker has a lock-free SPSC inbox (SpscRing); the worker busy-polls it, drains
+// it in batches and applies the commands to its books in submission order.
+//
+// Threading: the inboxes are single-producer, so all submissions to a given worker
+// must come from one thread at a time (typically one feed-handler thread for
+// everything, or one per worker). sync() belongs to that producer as well. A full inbox
+// makes the producer spin until the worker catches up.
+//
+// Symbols are added before start(). By default they are dealt round-robin over the
+// workers; worker i is pinned to cpus[i % cpus.size()] when a cpu list is given (Linux).
+template <class Book>
+class BookManager
+{
+   public:
+    static constexpr size_t kDefaultQueueCapacity = 16384; // commands per worker inbox
+
+    explicit BookManager(size_t workers, vector<int> cpus = {}, size_t queue_capacity = kDefaultQueueCapacity);
+    ~BookManager() { stop(); }
+    BookManager(const BookManager &) = delete;
+    BookManager &operator=(const BookManager &) = delete;
+
+    // New book with its own tick size, owned by `worker` (round-robin if omitted)
+    SymbolId add_symbol(Price tick_size = 0.01, size_t worker = size_t(-1));
+    size_t num_symbols() const { return books.size(); }
+    size_t num_workers() const { return workers.size(); }
+    size_t worker_of(SymbolId s) const { return owner[s]; }
+
+    // Called on the worker thread after every add_and_match that produced fills.
+    // Set before start().
+    void on_fills(function<void(SymbolId, const vector<Fill> &)> fn) { fill_handler = std::move(fn); }
+
+    void start();
+    // Apply everything already submitted, then join the workers
+    void stop();
+    // Wait until every command submitted so far has been applied
+    void sync();
+
+    // Queue an operation. These return false only if the command cannot be queued
+    // (unknown symbol or id longer than kJournalMaxId); the book's own accept/reject
+    // shows up in stats(). Without t the command is stamped by its book's clock when
+    // the worker applies it (see BasicOrderBook::set_clock). Producer thread only.
+    bool add_order(SymbolId s, string_view id, Side side, Price price, uint64_t qty, TimePoint t = kBookTime);
+    bool add_and_match(SymbolId s, string_view id, Side side, Price price, uint64_t qty, TimePoint t = kBookTime);
+    bool amend_order(SymbolId s, string_view id, optional<Price> new_price, optional<uint64_t> new_qty,
+                     TimePoint t = kBookTime);
+    bool remove_order(SymbolId s, string_view id, TimePoint t = kBookTime);
+    bool submit(const BookCommand &cmd);
+    // Queue n commands; consecutive commands for the same worker are published together
+    size_t submit(const BookCommand *cmds, size_t n);
+
+    struct Stats {
+        uint64_t applied = 0;  // commands the book accepted
+        uint64_t rejected = 0; // commands the book rejected
+    };
+    Stats stats() const;
+
+    // Direct access to a book. Only safe while no worker can touch it: before start(),
+    // after stop(), or after sync() with no producer submitting.
+    Book &book(SymbolId s) { return *books[s]; }
+    const Book &book(SymbolId s) const { return *books[s]; }
+
+   private:
+    // Per-worker inbox and counters, padded so workers don't share cache lines
+    struct alignas(64) Worker {
+        explicit Worker(size_t capacity) : inbox(capacity) {}
+        SpscRing<BookCommand> inbox;
+        uint64_t submitted = 0;   // producer-owned
+        alignas(64) atomic<bool> stopping{false};
+        atomic<uint64_t> done{0}; // commands fully applied
+        atomic<uint64_t> applied{0};
+        atomic<uint64_t> rejected{0};
+        int cpu = -1;
+        thread th;
+    };
+
+    void run(Worker &w);
+
+    vector<unique_ptr<Book>> books;
+    vector<uint32_t> owner; // symbol -> worker
+    vector<unique_ptr<Worker>> workers;
+    size_t next_worker = 0;
+    function<void(SymbolId, const vector<Fill> &)> fill_handler;
+    bool running = false;
+};
+
+extern template class BookManager<OrderBook>;
+extern template class BookManager<LadderOrderBook>;
+
+// Pin the calling thread to one cpu (no-op where thread affinity isn't supported)
+bool pin_current_thread(int cpu);
+
+} // namespace ob
@@ -0,0 +1,77 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace ob
+{
+
+// Fixed-capacity FIFO of events, allocated once by reset() and never resized.
+// Single-threaded: the producer pushes and the consumer drains in batches from the
+// same thread. When the ring is full new events are dropped and counted, so a
+// consumer that sees dropped() != 0 knows it must resynchronise (e.g. from a snapshot).
+template <class T>
+class EventRing
+{
+   public:
+    EventRing() = default;
+    explicit EventRing(size_t capacity) { reset(capacity); }
+
+    // Preallocate room for at least `capacity` events (rounded up to a power of two)
+    // and clear the ring; 0 releases the buffer
+    void reset(size_t capacity)
+    {
+        size_t cap = 0;
+        if (capacity)
+            for (cap = 1; cap < capacity; cap <<= 1) {}
+        buf.reset(cap ? new T[cap] : nullptr);
+        mask = cap ? cap - 1 : 0;
+        cap_ = cap;
+        head = tail = 0;
+        dropped_ = 0;
+    }
+
+    bool enabled() const { return cap_ != 0; }
+    size_t capacity() const { return cap_; }
+    size_t size() const { return size_t(tail - head); }
+    bool empty() const { return head == tail; }
+
+    // Events lost to a full ring since the last clear_dropped()
+    uint64_t dropped() const { return dropped_; }
+    void clear_dropped() { dropped_ = 0; }
+
+    bool push(const T &ev)
+    {
+        if (size() == cap_)
+        {
+            ++dropped_;
+            return false;
+        }
+        buf[tail++ & mask] = ev;
+        return true;
+    }
+
+    // Hand up to max_events queued events to f(const T *events, size_t n) as at most
+    // two contiguous runs, oldest first, and remove them. Returns the number drained.
+    template <class F>
+    size_t drain(F &&f, size_t max_events = SIZE_MAX)
+    {
+        size_t n = std::min(size(), max_events);
+        size_t first = std::min(n, cap_ - size_t(head & mask));
+        if (first) f(&buf[head & mask], first);
+        if (n > first) f(&buf[0], n - first);
+        head += n;
+        return n;
+    }
+
+   private:
+    std::unique_ptr<T[]> buf;
+    size_t cap_ = 0;
+    uint64_t mask = 0;
+    uint64_t head = 0; // next to drain
+    uint64_t tail = 0; // next to fill
+    uint64_t dropped_ = 0;
+};
+
+} // namespace ob
@@ -0,0 +1,135 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace ob
+{
+
+// Open-addressing hash index from string keys to 32-bit handles, for keys whose text is
+// stored by the owner (IdInterner's slots) and reached through key_of(handle). A slot is
+// 8 bytes, the handle plus a 16-bit hash fingerprint and the entry's probe distance, so
+// a probe usually stays within one cache line and key text is only compared on a
+// fingerprint match. Robin Hood insertion keeps probe runs short and lets a miss stop
+// as soon as it passes an entry closer to home than itself; erase shifts the rest of
+// the run back one slot instead of leaving a tombstone, so churn never lengthens probes.
+// Nothing allocates until the table grows past 80% full; reserve() sizes it up front.
+class HandleIndex
+{
+   public:
+    using Handle = uint32_t;
+    static constexpr Handle kNone = UINT32_MAX;
+
+    static uint64_t hash(std::string_view key) { return std::hash<std::string_view>()(key); }
+
+    size_t size() const { return count; }
+    size_t capacity() const { return slots.size(); }
+
+    // Handle stored under key (h = hash(key)), or kNone
+    template <class KeyOf>
+    Handle find(std::string_view key, uint64_t h, const KeyOf &key_of) const
+    {
+        if (slots.empty()) return kNone;
+        const uint32_t fp = fingerprint(h);
+        size_t i = h & mask;
+        for (uint32_t d = 1;; ++d, i = (i + 1) & mask)
+        {
+            const Slot &s = slots[i];
+            if (dist(s) < d) return kNone; // empty, or an entry nearer home: key absent
+            if (dist(s) == d && (s.meta >> 16) == fp && key_of(s.handle) == key) return s.handle;
+        }
+    }
+
+    // Add handle v under a key known to be absent (h = hash of its key). key_of(v) must
+    // already return the key: growing rehashes every entry from its key text.
+    template <class KeyOf>
+    void insert(uint64_t h, Handle v, const KeyOf &key_of)
+    {
+        if ((count + 1) * 5 > slots.size() * 4) rehash(std::max<size_t>(16, slots.size() * 2), key_of);
+        Slot cur{v, fingerprint(h) << 16 | 1};
+        size_t i = h & mask;
+        for (;;)
+        {
+            Slot &s = slots[i];
+            if (dist(s) == 0)
+            {
+                s = cur;
+                ++count;
+                return;
+            }
+            if (dist(s) < dist(cur)) std::swap(s, cur); // take the slot from a richer entry
+            if (dist(cur) == kMaxDist)
+            {
+                // 64k-long run (only a flood of colliding keys gets here): grow, then
+                // place whatever entry is in hand
+                rehash(slots.size() * 2, key_of);
+                h = hash(key_of(cur.handle));
+                cur = {cur.handle, fingerprint(h) << 16 | 1};
+                i = h & mask;
+                continue;
+            }
+            ++cur.meta;
+            i = (i + 1) & mask;
+        }
+    }
+
+    // Remove handle v, stored under a key hashing to h. False if it isn't there.
+    bool erase(uint64_t h, Handle v)
+    {
+        if (slots.empty()) return false;
+        size_t i = h & mask;
+        for (uint32_t d = 1;; ++d, i = (i + 1) & mask)
+        {
+            if (dist(slots[i]) < d) return false;
+            if (slots[i].handle == v) break;
+        }
+        // backward shift: pull each following displaced entry one slot nearer home
+        for (size_t next = (i + 1) & mask; dist(slots[next]) > 1; i = next, next = (next + 1) & mask)
+        {
+            slots[i] = slots[next];
+            --slots[i].meta;
+        }
+        slots[i] = Slot{};
+        --count;
+        return true;
+    }
+
+    // Room for n entries before the table has to grow
+    template <class KeyOf>
+    void reserve(size_t n, const KeyOf &key_of)
+    {
+        size_t cap = 16;
+        while (cap * 4 < n * 5) cap <<= 1;
+        if (cap > slots.size()) rehash(cap, key_of);
+    }
+
+   private:
+    struct Slot {
+        Handle handle;
+        uint32_t meta; // fingerprint << 16 | probe distance + 1 (0 = empty)
+    };
+    static constexpr uint32_t kMaxDist = 0xffff;
+
+    static uint32_t dist(const Slot &s) { return s.meta & 0xffff; }
+    static uint32_t fingerprint(uint64_t h) { return uint32_t(h >> 48); }
+
+    template <class KeyOf>
+    void rehash(size_t cap, const KeyOf &key_of)
+    {
+        std::vector<Slot> old(cap);
+        old.swap(slots);
+        mask = cap - 1;
+        count = 0;
+        for (const Slot &s : old)
+            if (dist(s)) insert(hash(key_of(s.handle)), s.handle, key_of);
+    }
+
+    std::vector<Slot> slots;
+    size_t mask = 0;
+    size_t count = 0;
+};
+
+} // namespace ob
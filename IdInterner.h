@@ -0,0 +1,96 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "HandleIndex.h"
+
+namespace ob
+{
+
+// Dense integer handle for an order id. Handles are recycled once released, so a
+// handle only names the same order while that order is on the book.
+using OrderHandle = uint32_t;
+constexpr OrderHandle kInvalidHandle = std::numeric_limits<OrderHandle>::max();
+static_assert(HandleIndex::kNone == kInvalidHandle, "index misses are reported as kInvalidHandle");
+
+// Maps external string ids to dense handles (0..capacity()-1) and back.
+// Each id's text is stored once, in a handle-indexed slot; the hash index (HandleIndex)
+// holds only handles and reads key text from the slots. Released slots keep their
+// buffer, so steady-state interning of ids of similar length does not allocate.
+class IdInterner
+{
+   public:
+    // Handle for id, allocating one if the id is new
+    OrderHandle intern(std::string_view id)
+    {
+        uint64_t hash = HandleIndex::hash(id);
+        OrderHandle h = handles.find(id, hash, key_of());
+        if (h != kInvalidHandle) return h;
+
+        if (!free_handles.empty())
+        {
+            h = free_handles.back();
+            free_handles.pop_back();
+        }
+        else
+        {
+            h = OrderHandle(names.size());
+            names.emplace_back();
+            in_use.push_back(false);
+        }
+        names[h].assign(id);
+        in_use[h] = true;
+        handles.insert(hash, h, key_of());
+        return h;
+    }
+
+    // Handle for an id already interned (kInvalidHandle if unknown)
+    OrderHandle find(std::string_view id) const
+    {
+        return handles.find(id, HandleIndex::hash(id), key_of());
+    }
+
+    // True if h is currently issued (interned and not released)
+    bool contains(OrderHandle h) const { return h < in_use.size() && in_use[h]; }
+
+    // Text of a handle's id. The view stays readable after release until the handle
+    // is reused by a later intern().
+    std::string_view id(OrderHandle h) const { return names[h]; }
+
+    // Forget the id -> handle mapping and make the handle available for reuse
+    void release(OrderHandle h)
+    {
+        handles.erase(HandleIndex::hash(names[h]), h);
+        in_use[h] = false;
+        free_handles.push_back(h);
+    }
+
+    // Make room for n live ids without rehashing (bulk loads)
+    void reserve(size_t n)
+    {
+        handles.reserve(n, key_of());
+        in_use.reserve(n);
+    }
+
+    // One past the largest handle ever issued
+    size_t capacity() const { return names.size(); }
+
+   private:
+    // How the index reads a handle's key text
+    struct KeyOf {
+        const std::deque<std::string> &names;
+        std::string_view operator()(OrderHandle h) const { return names[h]; }
+    };
+    KeyOf key_of() const { return {names}; }
+
+    std::deque<std::string> names; // deque: slots never move, so id() views stay valid
+    HandleIndex handles;
+    std::vector<bool> in_use;
+    std::vector<OrderHandle> free_handles;
+};
+
+} // namespace ob
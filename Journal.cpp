@@ -0,0 +1,129 @@
+#include "Journal.h"
+#include <cstring>
+
+#include "Price.h"
+
+namespace ob
+{
+
+static constexpr char kJournalMagic[8] = "OBJRNL1";
+
+bool JournalWriter::open(const std::string &path, int64_t tick_units)
+{
+    close();
+    file = std::fopen(path.c_str(), "wb");
+    if (!file) return false;
+
+    JournalHeader h{};
+    std::memcpy(h.magic, kJournalMagic, sizeof h.magic);
+    h.record_size = sizeof(JournalRecord);
+    h.price_decimals = OB_PRICE_DECIMALS;
+    h.tick_units = tick_units;
+    if (std::fwrite(&h, sizeof h, 1, file) != 1)
+    {
+        std::fclose(file);
+        file = nullptr;
+        return false;
+    }
+
+    cur.reset(new Block);
+    appended = 0;
+    stopping = failed = false;
+    worker = std::thread([this] { run(); });
+    return true;
+}
+
+void JournalWriter::hand_off()
+{
+    std::unique_ptr<Block> next;
+    {
+        std::lock_guard<std::mutex> lk(mu);
+        appended += cur->used;
+        pending.push_back(std::move(cur));
+        if (!spare.empty())
+        {
+            next = std::move(spare.back());
+            spare.pop_back();
+        }
+    }
+    cv.notify_one();
+    if (!next) next.reset(new Block); // writer is behind: grow rather than wait
+    next->used = 0;
+    cur = std::move(next);
+}
+
+void JournalWriter::flush()
+{
+    if (!file) return;
+    if (cur->used) hand_off();
+    std::unique_lock<std::mutex> lk(mu);
+    cv.wait(lk, [this] { return pending.empty() && !writing; });
+    std::fflush(file);
+}
+
+void JournalWriter::close()
+{
+    if (!file) return;
+    flush();
+    {
+        std::lock_guard<std::mutex> lk(mu);
+        stopping = true;
+    }
+    cv.notify_all();
+    worker.join();
+    std::fclose(file);
+    file = nullptr;
+    cur.reset();
+    pending.clear();
+    spare.clear();
+}
+
+bool JournalWriter::good() const
+{
+    std::lock_guard<std::mutex> lk(mu);
+    return !failed;
+}
+
+// Background thread: write pending blocks in order, then recycle them
+void JournalWriter::run()
+{
+    std::unique_lock<std::mutex> lk(mu);
+    for (;;)
+    {
+        cv.wait(lk, [this] { return stopping || !pending.empty(); });
+        if (pending.empty()) return; // stopping, nothing left
+
+        std::unique_ptr<Block> b = std::move(pending.front());
+        pending.erase(pending.begin());
+        writing = true;
+        lk.unlock();
+        bool ok = std::fwrite(b->records, sizeof(JournalRecord), b->used, file) == b->used;
+        lk.lock();
+        writing = false;
+        failed |= !ok;
+        spare.push_back(std::move(b));
+        cv.notify_all(); // wake flush()
+    }
+}
+
+JournalReader::~JournalReader()
+{
+    if (file) std::fclose(file);
+}
+
+bool JournalReader::open(const std::string &path)
+{
+    if (file) std::fclose(file);
+    file = std::fopen(path.c_str(), "rb");
+    if (!file) return false;
+    if (std::fread(&hdr, sizeof hdr, 1, file) != 1 || std::memcmp(hdr.magic, kJournalMagic, sizeof hdr.magic) != 0 ||
+        hdr.record_size != sizeof(JournalRecord) || hdr.price_decimals != OB_PRICE_DECIMALS)
+    {
+        std::fclose(file);
+        file = nullptr;
+        return false;
+    }
+    return true;
+}
+
+} // namespace ob
@@ -0,0 +1,181 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace ob
+{
+
+// Longest order id a journal record can carry. Books with a journal attached reject
+// longer ids rather than write a truncated record.
+constexpr size_t kJournalMaxId = 36;
+
+enum class JournalOp : uint8_t { Add = 1, AddMatch, Amend, Remove };
+
+// Amend flags: which of the optional fields were given
+constexpr uint8_t kJournalHasPrice = 1;
+constexpr uint8_t kJournalHasQty = 2;
+
+// One book operation as a fixed 64-byte record, written in host byte order.
+// AddMatch journals the aggressive order itself; replaying it re-runs the match,
+// which is deterministic given the same prior state.
+struct JournalRecord {
+    int64_t time_ns;      // operation TimePoint, ns since the system_clock epoch
+    int64_t price_units;  // Add/AddMatch: limit price; Amend: new price if kJournalHasPrice
+    uint64_t quantity;    // Add/AddMatch: quantity; Amend: new quantity if kJournalHasQty
+    JournalOp op;
+    uint8_t side;         // Side as integer (Add/AddMatch)
+    uint8_t flags;        // kJournalHas* (Amend)
+    uint8_t id_len;
+    char id[kJournalMaxId];
+
+    std::string_view order_id() const { return {id, id_len}; }
+};
+static_assert(sizeof(JournalRecord) == 64, "journal records are fixed 64-byte slots");
+
+// Fill a record; id must be at most kJournalMaxId bytes
+inline JournalRecord make_journal_record(JournalOp op, std::string_view id, int64_t time_ns, uint8_t side = 0,
+                                         uint8_t flags = 0, int64_t price_units = 0, uint64_t quantity = 0)
+{
+    JournalRecord r{};
+    r.time_ns = time_ns;
+    r.price_units = price_units;
+    r.quantity = quantity;
+    r.op = op;
+    r.side = side;
+    r.flags = flags;
+    r.id_len = uint8_t(id.size());
+    std::memcpy(r.id, id.data(), id.size());
+    return r;
+}
+
+// File header, followed by a dense array of JournalRecord
+struct JournalHeader {
+    char magic[8];          // "OBJRNL1\0"
+    uint32_t record_size;   // sizeof(JournalRecord)
+    uint32_t price_decimals; // OB_PRICE_DECIMALS of the writer
+    int64_t tick_units;     // tick size of the journalled book, in Price units
+    int64_t reserved;
+};
+static_assert(sizeof(JournalHeader) == 32, "fixed journal header");
+
+// time_ns of a record the applying book stamps with its own clock (BookManager
+// commands queued without a time). Journals never contain it: a book journals the
+// time it resolved.
+constexpr int64_t kJournalBookTime = INT64_MIN;
+
+// TimePoint <-> ns since the system_clock epoch, as stored in journal and snapshot files
+inline int64_t time_to_ns(std::chrono::system_clock::time_point t)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(t.time_since_epoch()).count();
+}
+inline std::chrono::system_clock::time_point time_from_ns(int64_t ns)
+{
+    return std::chrono::system_clock::time_point(
+        std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::nanoseconds(ns)));
+}
+
+// Append-only journal writer. append() copies the record into the current in-memory
+// block and returns; full blocks are handed to a background thread that writes them
+// out, so the mutation path never waits on the disk. Blocks are recycled, and if the
+// writer falls behind a new block is allocated instead of blocking the producer.
+// append() must be called from one thread at a time (the book's thread).
+class JournalWriter
+{
+   public:
+    static constexpr size_t kBlockRecords = 4096; // 256 KiB per block
+
+    JournalWriter() = default;
+    ~JournalWriter() { close(); }
+    JournalWriter(const JournalWriter &) = delete;
+    JournalWriter &operator=(const JournalWriter &) = delete;
+
+    // Create (truncate) path and write the header; false if the file can't be opened
+    bool open(const std::string &path, int64_t tick_units);
+    bool is_open() const { return file != nullptr; }
+
+    void append(const JournalRecord &r)
+    {
+        cur->records[cur->used++] = r;
+        if (cur->used == kBlockRecords) hand_off();
+    }
+
+    // Hand off the partial block and wait until everything appended so far is written
+    void flush();
+    // Flush, stop the writer thread and close the file
+    void close();
+
+    // Records appended since open()
+    uint64_t records() const { return appended + cur_used(); }
+    // False once a write to the file has failed
+    bool good() const;
+
+   private:
+    struct Block {
+        JournalRecord records[kBlockRecords];
+        size_t used = 0;
+    };
+
+    size_t cur_used() const { return cur ? cur->used : 0; }
+    void hand_off();
+    void run();
+
+    std::FILE *file = nullptr;
+    std::unique_ptr<Block> cur;
+    uint64_t appended = 0; // records in handed-off blocks
+
+    // shared with the writer thread
+    mutable std::mutex mu;
+    std::condition_variable cv;
+    std::vector<std::unique_ptr<Block>> pending; // full blocks, oldest first
+    std::vector<std::unique_ptr<Block>> spare;   // written blocks for reuse
+    bool stopping = false;
+    bool writing = false;
+    bool failed = false;
+    std::thread worker;
+};
+
+// Sequential journal reader: the records are read in large blocks straight into a
+// record array, with no per-record parsing.
+class JournalReader
+{
+   public:
+    JournalReader() = default;
+    ~JournalReader();
+    JournalReader(const JournalReader &) = delete;
+    JournalReader &operator=(const JournalReader &) = delete;
+
+    // Open and validate the header; false on a missing file or incompatible format
+    bool open(const std::string &path);
+    const JournalHeader &header() const { return hdr; }
+
+    // Call f(const JournalRecord &) for every record in file order. Returns the count.
+    template <class F>
+    uint64_t for_each(F &&f)
+    {
+        constexpr size_t kBatch = 16384;
+        std::unique_ptr<JournalRecord[]> buf(new JournalRecord[kBatch]);
+        uint64_t n = 0;
+        size_t got;
+        while (file && (got = std::fread(buf.get(), sizeof(JournalRecord), kBatch, file)) > 0)
+        {
+            for (size_t i = 0; i < got; ++i) f(buf[i]);
+            n += got;
+        }
+        return n;
+    }
+
+   private:
+    std::FILE *file = nullptr;
+    JournalHeader hdr{};
+};
+
+} // namespace ob
@@ -0,0 +1,171 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace ob
+{
+
+// Cheap timestamp for latency measurement: TSC cycles on x86, steady_clock ns elsewhere
+inline uint64_t cycle_now()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+}
+
+// cycle_now() ticks per nanosecond, calibrated once against steady_clock
+inline double cycles_per_ns()
+{
+    static const double ratio = [] {
+#if defined(__x86_64__) || defined(__i386__)
+        auto t0 = std::chrono::steady_clock::now();
+        uint64_t c0 = cycle_now();
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        uint64_t c1 = cycle_now();
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - t0).count();
+        return ns > 0 ? double(c1 - c0) / double(ns) : 1.0;
+#else
+        return 1.0;
+#endif
+    }();
+    return ratio;
+}
+
+// HDR-style log-bucketed histogram: values below 2^SubBits are counted exactly; above
+// that, each power of two is split into 2^SubBits linear sub-buckets, so any recorded
+// value is reported within 1/2^SubBits (~6% for SubBits = 4). Fixed size, no allocation.
+class LatencyHistogram
+{
+    static constexpr unsigned SubBits = 4;
+    static constexpr uint64_t SubCount = uint64_t(1) << SubBits;
+    static constexpr size_t Buckets = (64 - SubBits + 1) * SubCount;
+
+   public:
+    void record(uint64_t v)
+    {
+        ++counts[bucket(v)];
+        ++total;
+        sum += v;
+        if (v > max_v) max_v = v;
+    }
+
+    uint64_t count() const { return total; }
+    uint64_t max() const { return max_v; }
+    double mean() const { return total ? double(sum) / double(total) : 0.0; }
+
+    // Smallest recorded bucket bound such that a fraction q (0..1) of samples are <= it
+    uint64_t percentile(double q) const
+    {
+        if (total == 0) return 0;
+        uint64_t rank = uint64_t(q * double(total) + 0.5);
+        if (rank == 0) rank = 1;
+        uint64_t seen = 0;
+        for (size_t i = 0; i < Buckets; ++i)
+        {
+            seen += counts[i];
+            if (seen >= rank) return std::min(upper_bound(i), max_v);
+        }
+        return max_v;
+    }
+
+    void reset() { *this = LatencyHistogram(); }
+
+   private:
+    static size_t bucket(uint64_t v)
+    {
+        if (v < SubCount) return size_t(v);
+        unsigned msb = 63u - unsigned(__builtin_clzll(v));
+        unsigned shift = msb - SubBits;
+        return size_t(shift + 1) * SubCount + size_t((v >> shift) - SubCount);
+    }
+    // Largest value that lands in bucket i
+    static uint64_t upper_bound(size_t i)
+    {
+        if (i < SubCount) return i;
+        unsigned shift = unsigned(i / SubCount) - 1;
+        uint64_t lo = (SubCount + i % SubCount) << shift;
+        return lo + ((uint64_t(1) << shift) - 1);
+    }
+
+    std::array<uint64_t, Buckets> counts{};
+    uint64_t total = 0;
+    uint64_t sum = 0;
+    uint64_t max_v = 0;
+};
+
+// One histogram per operation kind (Op is an enum class ending in Count), recorded in
+// cycle_now() units. Nested timed calls are attributed to the outermost one, and the
+// outermost call can relabel itself once it knows which path it took.
+template <class Op>
+class OpLatency
+{
+   public:
+    void enter(Op op)
+    {
+        if (depth++ == 0)
+        {
+            current = op;
+            start = cycle_now();
+        }
+    }
+    void leave()
+    {
+        if (--depth == 0) hist[size_t(current)].record(cycle_now() - start);
+    }
+    void relabel(Op op) { current = op; }
+
+    const LatencyHistogram &operator[](Op op) const { return hist[size_t(op)]; }
+    void reset() { for (auto &h : hist) h.reset(); }
+
+    // One line per op with samples: count, p50/p99/p99.9/max and mean in ns
+    template <class NameFn>
+    void dump(std::ostream &os, NameFn name) const
+    {
+        double cpn = cycles_per_ns();
+        auto ns = [cpn](double cycles) { return uint64_t(cycles / cpn + 0.5); };
+        for (size_t i = 0; i < hist.size(); ++i)
+        {
+            const auto &h = hist[i];
+            if (!h.count()) continue;
+            os << name(Op(i)) << ": n=" << h.count()
+               << " p50=" << ns(double(h.percentile(0.50))) << "ns"
+               << " p99=" << ns(double(h.percentile(0.99))) << "ns"
+               << " p99.9=" << ns(double(h.percentile(0.999))) << "ns"
+               << " max=" << ns(double(h.max())) << "ns"
+               << " mean=" << ns(h.mean()) << "ns\n";
+        }
+    }
+
+   private:
+    std::array<LatencyHistogram, size_t(Op::Count)> hist{};
+    Op current{};
+    int depth = 0;
+    uint64_t start = 0;
+};
+
+// RAII timer around a public call
+template <class Op>
+class LatencyScope
+{
+   public:
+    LatencyScope(OpLatency<Op> &l, Op op) : l(l) { l.enter(op); }
+    ~LatencyScope() { l.leave(); }
+    LatencyScope(const LatencyScope &) = delete;
+    LatencyScope &operator=(const LatencyScope &) = delete;
+
+   private:
+    OpLatency<Op> &l;
+};
+
+} // namespace ob
@@ -0,0 +1,106 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace ob
+{
+
+// Free-list storage for the nodes of node-based containers (std::set, std::map) owned
+// by one object. Nodes are carved from fixed-size chunks that are never freed while the
+// pool exists; a deallocated node goes on a free list and the next allocation takes it
+// back, so once the pool has grown to the peak node count, insert/erase never touch the
+// heap. The pool serves one node size, fixed by its first allocation: every container
+// sharing it must have the same node type (e.g. two sets with the same key).
+class NodePool
+{
+    static constexpr size_t kChunkNodes = 256;
+
+   public:
+    NodePool() = default;
+    NodePool(const NodePool &) = delete;
+    NodePool &operator=(const NodePool &) = delete;
+
+    void *allocate(size_t bytes)
+    {
+        if (!node_size) node_size = round_up(bytes);
+        if (!free_list)
+        {
+            constexpr size_t w = sizeof(std::max_align_t);
+            chunks.emplace_back(new std::max_align_t[(node_size * kChunkNodes + w - 1) / w]);
+            char *base = reinterpret_cast<char *>(chunks.back().get());
+            for (size_t i = kChunkNodes; i-- > 0;)
+                free_list = new (base + i * node_size) FreeNode{free_list};
+        }
+        FreeNode *n = free_list;
+        free_list = n->next;
+        return n;
+    }
+
+    void deallocate(void *p) { free_list = new (p) FreeNode{free_list}; }
+
+    // Size of the nodes served (0 before the first allocation)
+    size_t node_bytes() const { return node_size; }
+    // Number of nodes backed by allocated chunks
+    size_t capacity() const { return chunks.size() * kChunkNodes; }
+
+   private:
+    struct FreeNode {
+        FreeNode *next;
+    };
+    static size_t round_up(size_t bytes)
+    {
+        constexpr size_t a = alignof(std::max_align_t);
+        return (std::max(bytes, sizeof(FreeNode)) + a - 1) / a * a;
+    }
+
+    std::vector<std::unique_ptr<std::max_align_t[]>> chunks;
+    FreeNode *free_list = nullptr;
+    size_t node_size = 0;
+};
+
+// Allocator handing single nodes out of a shared NodePool; anything else (a size the pool
+// does not serve, n > 1) goes to operator new. Copies share the pool, which lives as long
+// as any container using it, and the allocator travels with a moved container, so the
+// owner can be moved freely.
+template <class T>
+struct NodePoolAllocator {
+    using value_type = T;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    explicit NodePoolAllocator(std::shared_ptr<NodePool> p) : pool(std::move(p)) {}
+    template <class U>
+    NodePoolAllocator(const NodePoolAllocator<U> &o) : pool(o.pool) {}
+
+    T *allocate(size_t n)
+    {
+        if (pooled(n)) return static_cast<T *>(pool->allocate(sizeof(T)));
+        return static_cast<T *>(::operator new(n * sizeof(T)));
+    }
+    void deallocate(T *p, size_t n)
+    {
+        if (pooled(n)) pool->deallocate(p);
+        else ::operator delete(p);
+    }
+
+    template <class U>
+    bool operator==(const NodePoolAllocator<U> &o) const { return pool == o.pool; }
+    template <class U>
+    bool operator!=(const NodePoolAllocator<U> &o) const { return pool != o.pool; }
+
+    std::shared_ptr<NodePool> pool;
+
+   private:
+    bool pooled(size_t n) const
+    {
+        return n == 1 && alignof(T) <= alignof(std::max_align_t) &&
+               (pool->node_bytes() == 0 || pool->node_bytes() >= sizeof(T));
+    }
+};
+
+} // namespace ob
@@ -0,0 +1,124 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace ob
+{
+
+// Three-level occupancy bitmap: one bit per slot; a summary level in which bit w is set
+// while word w has any bit set (one summary word per 4096 slots); and a top level in
+// which bit s is set while summary word s is non-zero (one top word per 2^18 slots).
+// Finding the next/previous occupied slot is a ctz/clz on the current word, its summary
+// word and top word, then one more ctz/clz per level on the way back down. Only the top
+// level is scanned word by word, one word per 2^18 empty slots: at most 16 words for the
+// largest PriceLadder array (2 * kMaxSpanTicks = 2^22 slots).
+class OccupancyBitmap
+{
+   public:
+    static constexpr size_t npos = size_t(-1);
+
+    // Resize to `bits` slots, all clear
+    void assign(size_t bits)
+    {
+        words.assign((bits + 63) / 64, 0);
+        summary.assign((words.size() + 63) / 64, 0);
+        top.assign((summary.size() + 63) / 64, 0);
+    }
+
+    bool test(size_t i) const { return (words[i >> 6] >> (i & 63)) & 1; }
+    void set(size_t i)
+    {
+        words[i >> 6] |= bit(i);
+        summary[i >> 12] |= bit(i >> 6);
+        top[i >> 18] |= bit(i >> 12);
+    }
+    void reset(size_t i)
+    {
+        if ((words[i >> 6] &= ~bit(i)) == 0 && (summary[i >> 12] &= ~bit(i >> 6)) == 0)
+            top[i >> 18] &= ~bit(i >> 12);
+    }
+
+    // First set slot at or after i (npos if none)
+    size_t find_next(size_t i) const
+    {
+        size_t w = i >> 6;
+        if (w >= words.size()) return npos;
+        uint64_t m = words[w] & (~uint64_t(0) << (i & 63));
+        if (m) return (w << 6) | ctz(m);
+        w = next_word(w + 1);
+        return w == npos ? npos : (w << 6) | ctz(words[w]);
+    }
+    // Last set slot at or before i (npos if none); i must be a valid slot
+    size_t find_prev(size_t i) const
+    {
+        size_t w = i >> 6;
+        uint64_t m = words[w] & (~uint64_t(0) >> (63 - (i & 63)));
+        if (m) return (w << 6) | msb(m);
+        if (w == 0) return npos;
+        w = prev_word(w - 1);
+        return w == npos ? npos : (w << 6) | msb(words[w]);
+    }
+
+   private:
+    static uint64_t bit(size_t i) { return uint64_t(1) << (i & 63); }
+    static size_t ctz(uint64_t m) { return size_t(__builtin_ctzll(m)); }
+    static size_t msb(uint64_t m) { return 63 - size_t(__builtin_clzll(m)); }
+
+    // First non-empty word at or after w
+    size_t next_word(size_t w) const
+    {
+        size_t s = w >> 6;
+        if (s >= summary.size()) return npos;
+        uint64_t m = summary[s] & (~uint64_t(0) << (w & 63));
+        if (!m)
+        {
+            if ((s = next_summary(s + 1)) == npos) return npos;
+            m = summary[s];
+        }
+        return (s << 6) | ctz(m);
+    }
+    // Last non-empty word at or before w
+    size_t prev_word(size_t w) const
+    {
+        size_t s = w >> 6;
+        uint64_t m = summary[s] & (~uint64_t(0) >> (63 - (w & 63)));
+        if (!m)
+        {
+            if (s == 0 || (s = prev_summary(s - 1)) == npos) return npos;
+            m = summary[s];
+        }
+        return (s << 6) | msb(m);
+    }
+    // First non-zero summary word at or after s
+    size_t next_summary(size_t s) const
+    {
+        size_t t = s >> 6;
+        if (t >= top.size()) return npos;
+        uint64_t m = top[t] & (~uint64_t(0) << (s & 63));
+        while (!m)
+        {
+            if (++t == top.size()) return npos;
+            m = top[t];
+        }
+        return (t << 6) | ctz(m);
+    }
+    // Last non-zero summary word at or before s
+    size_t prev_summary(size_t s) const
+    {
+        size_t t = s >> 6;
+        uint64_t m = top[t] & (~uint64_t(0) >> (63 - (s & 63)));
+        while (!m)
+        {
+            if (t-- == 0) return npos;
+            m = top[t];
+        }
+        return (t << 6) | msb(m);
+    }
+
+    std::vector<uint64_t> words;
+    std::vector<uint64_t> summary; // one word per 4096 slots
+    std::vector<uint64_t> top;     // one word per 2^18 slots
+};
+
+} // namespace ob
@@ -1,78 +1,263 @@
 #include "OrderBook.h"
 #include <chrono>
+#include <cstdio>
+#include <cstring>
+
 namespace ob
 {
 
-bool OrderBook::add_order(const string &id, Side side, double price, uint64_t qty, TimePoint t)
+template <class Backend>
+bool BasicOrderBook<Backend>::add_order(const string &id, Side side, Price price, uint64_t qty, TimePoint t)
+{
+    OB_TIME(Add);
+    OrderHandle h = ids.intern(id);
+    if (add_order(h, side, price, qty, t))
+        return true;
+    if (!is_live(h))
+        ids.release(h); // rejected new id: don't keep it interned
+    return false;
+}
+
+template <class Backend>
+bool BasicOrderBook<Backend>::add_order(OrderHandle h, Side side, Price price, uint64_t qty, TimePoint t)
+{
+    OB_TIME(Add);
+    if (!can_add(h, side, price, qty))
+        return false; // rejected before the clock is read: no stamp is used up
+    t = stamp(t);
+    insert_order(h, side, price, qty, t);
+    journal_op(JournalOp::Add, h, t, side, 0, price, qty);
+    return true;
+}
+
+template <class Backend>
+void BasicOrderBook<Backend>::insert_order(OrderHandle h, Side side, Price price, uint64_t qty, TimePoint t)
+{
+    // push_back (new order arrives now -> last_update_time is current)
+    OrderNode *order = orders.construct(h, h, side, qty);
+    info.construct(h, ids.id(h), t);
+    with_side(side, [&](auto &sb) { link_order(sb, order, price); });
+    by_created.emplace_hint(by_created.end(), t, h);
+    by_updated.emplace_hint(by_updated.end(), t, h);
+    publish_top();
+}
+
+// Append o at the back of the level for price, creating the level if needed
+template <class Backend>
+template <class SB>
+void BasicOrderBook<Backend>::link_order(SB &sb, OrderNode *o, Price price)
 {
-    if (orders_by_id.count(id)) 
-        return false; // id must be unique
+    bool created;
+    PriceLevel &pl = sb.level_at(price, created);
+    pl.push_back(o);
+    ++sb.totals.orders;
+    sb.totals.quantity += o->quantity;
+    publish_level(SB::side, pl, created);
+}
 
-    // Insert into correct side map
-    //auto &pl_map = (side == Side::Bid) ? bid_book : ask_book;
-    auto order = std::make_shared<Order>(id, side, price, qty, t);
-    if(side == Side::Bid)
+// Take o off its level (found through its level pointer); drops the level if it empties
+template <class Backend>
+template <class SB>
+void BasicOrderBook<Backend>::unlink_order(SB &sb, OrderNode *o)
+{
+    PriceLevel *pl = o->level;
+    pl->erase(o);
+    --sb.totals.orders;
+    sb.totals.quantity -= o->quantity;
+    publish_level(SB::side, *pl, false);
+    if (pl->empty())
     {
-        auto pit = bid_book.find(price);
-        if(pit == bid_book.end())
-            pit = bid_book.emplace(price, PriceLevel(price)).first;
-        
-        // push_back (new order arrives now -> last_update_time is current)  
-        pit->second.orders.push_back(order);
-        
-        //store lookup: pointer to price level (map key) and iterator to list element
-        auto list_it = prev(pit->second.orders.end());
-        orders_by_id[id] = {side, price, list_it};
-        order->last_txn = {TxnType::Add, t};
+        Price p = pl->price; // the key must outlive the level it names
+        sb.levels.erase(p);
     }
+}
+
+template <class Backend>
+MatchResult BasicOrderBook<Backend>::add_and_match(const string &id, Side side, Price price, uint64_t qty,
+                                     vector<Fill> &fills, TimePoint t)
+{
+    OB_TIME(AddMatch);
+    OrderHandle h = ids.intern(id);
+    auto res = add_and_match(h, side, price, qty, fills, t);
+    if (!res.accepted && !is_live(h))
+        ids.release(h); // rejected new id: don't keep it interned
+    return res;
+}
+
+template <class Backend>
+MatchResult BasicOrderBook<Backend>::add_and_match(OrderHandle h, Side side, Price price, uint64_t qty,
+                                     vector<Fill> &fills, TimePoint t)
+{
+    OB_TIME(AddMatch);
+    fills.clear();
+    return match_order(h, side, price, qty, fills, t);
+}
+
+template <class Backend>
+MatchResult BasicOrderBook<Backend>::match_order(OrderHandle h, Side side, Price price, uint64_t qty,
+                                                 vector<Fill> &fills, TimePoint t)
+{
+    if (!can_add(h, side, price, qty))
+        return {false, 0, 0};
+    t = stamp(t);
+    journal_op(JournalOp::AddMatch, h, t, side, 0, price, qty); // before a full fill releases h
+
+    Side opp_side = side == Side::Bid ? Side::Ask : Side::Bid;
+    uint64_t remaining = qty - with_side(opp_side, [&](auto &opp) { return sweep(opp, price, qty, fills, t); });
+
+    // rest whatever is left at the limit price; a fully filled order never rests,
+    // so its handle is released right away
+    if (remaining > 0)
+        insert_order(h, side, price, remaining, t);
     else
     {
-        auto pit = ask_book.find(price);
-        if(pit == ask_book.end())
-            pit = ask_book.emplace(price, PriceLevel(price)).first;
-        
-        // push_back (new order arrives now -> last_update_time is current)  
-        pit->second.orders.push_back(order);
-        
-        //store lookup: pointer to price level (map key) and iterator to list element
-        auto list_it = prev(pit->second.orders.end());
-        orders_by_id[id] = {side, price, list_it};
-        order->last_txn = {TxnType::Add, t}; 
+        release_id(h);
+        publish_top();
     }
-    return true;    
+
+    return {true, qty - remaining, remaining};
 }
 
-bool OrderBook::remove_order(const string &id, TimePoint t)
+template <class Backend>
+size_t BasicOrderBook<Backend>::apply_batch(const BookMutation *cmds, size_t n, vector<Fill> &fills, bool *ok,
+                                            TimePoint t)
 {
-    auto info_it = orders_by_id.find(id);
-    if (info_it == orders_by_id.end()) return false;
+    OB_TIME(Batch);
+    constexpr size_t kAhead = 4; // slots fetched kAhead mutations early, levels kAhead/2
+    fills.clear();
+    // the packet's one clock read: the first default stamp lands on it (or one tick past
+    // the last stamp), later ones follow a tick apart without reading the clock again
+    if (t == kBookTime) last_stamp = max(last_stamp, clock_now() - TimePoint::duration(1));
+    batching = true;
+    size_t accepted = 0;
+    for (size_t i = 0; i < n; ++i)
+    {
+        if (i + kAhead < n) orders.prefetch(cmds[i + kAhead].handle);
+        if (i + kAhead / 2 < n)
+            if (const OrderNode *next = orders.find(cmds[i + kAhead / 2].handle)) __builtin_prefetch(next->level);
 
-    auto &info = info_it->second;
-    auto &side = info.side;
-    auto &price = info.price;
+        const BookMutation &m = cmds[i];
+        bool r = false;
+        switch (m.op)
+        {
+            case JournalOp::Add:
+                r = add_order(m.handle, m.side, m.price, m.quantity, t);
+                break;
+            case JournalOp::AddMatch:
+                r = match_order(m.handle, m.side, m.price, m.quantity, fills, t).accepted;
+                break;
+            case JournalOp::Amend:
+                r = amend_order(m.handle, (m.flags & kJournalHasPrice) ? optional<Price>(m.price) : nullopt,
+                                (m.flags & kJournalHasQty) ? optional<uint64_t>(m.quantity) : nullopt, t);
+                break;
+            case JournalOp::Remove:
+                r = remove_order(m.handle, t);
+                break;
+        }
+        accepted += r;
+        if (ok) ok[i] = r;
+    }
+    batching = false;
+    for (OrderHandle h : batch_released)
+        if (ids.contains(h) && !is_live(h)) ids.release(h); // not re-added later in the packet
+    batch_released.clear();
+    publish_top();
+    return accepted;
+}
 
-    //auto &pl_map = (side == Side::Bid) ? bid_book : ask_book;
-    auto exe = [&, this](auto &pl_map)
+// Walk the opposite side best level first while it still crosses `limit`, filling up to
+// qty; returns the quantity filled
+template <class Backend>
+template <class SB>
+uint64_t BasicOrderBook<Backend>::sweep(SB &opp, Price limit, uint64_t qty, vector<Fill> &fills, TimePoint t)
+{
+    uint64_t remaining = qty;
+    auto pl_it = opp.levels.begin();
+    while (remaining > 0 && pl_it != opp.levels.end() && SB::crossed_by(pl_it->first, limit))
     {
-        auto pl_it = pl_map.find(price);
-        if (pl_it == pl_map.end()) 
-            return false; // shouldn't happen
+        auto &level = pl_it->second;
+        while (remaining > 0 && level.head)
+        {
+            OrderNode *maker = level.head;
+            OrderInfo *mi = info.get(maker->handle);
+            uint64_t q = min(remaining, maker->quantity);
+            remaining -= q;
+            level.reduce(maker, q);
+            opp.totals.quantity -= q;
+            mi->last_txn = {TxnType::Fill, t};
+            fills.push_back({maker->handle, mi->id, pl_it->first, q, maker->quantity});
 
-        // erase order from list
-        pl_it->second.orders.erase(info.list_it);
+            // fully filled makers leave the book; partial fills keep their priority
+            if (maker->quantity == 0)
+            {
+                --opp.totals.orders;
+                level.erase(maker);
+                retire(maker->handle);
+            }
+        }
 
-        // if price level empty, remove it
-        if (pl_it->second.orders.empty()) 
-            pl_map.erase(pl_it);
+        publish_level(SB::side, level, false);
+        if (level.empty())
+            pl_it = opp.levels.erase(pl_it);
+    }
+    return qty - remaining;
+}
 
-        orders_by_id.erase(info_it);
-        return true;
-    };
-    
-    if(side == Side::Bid)
-      return exe(bid_book);
+template <class Backend>
+bool BasicOrderBook<Backend>::remove_order(const string &id, TimePoint t)
+{
+    OB_TIME(Remove);
+    return remove_order(ids.find(id), t);
+}
+
+template <class Backend>
+bool BasicOrderBook<Backend>::remove_order(OrderHandle h, TimePoint t)
+{
+    OB_TIME(Remove);
+    if (!is_live(h)) return false;
+
+    // the order knows its level: no price lookup unless the level empties
+    OrderNode *order = orders.get(h);
+    with_side(order->side, [&](auto &sb) { unlink_order(sb, order); });
+
+    journal_op(JournalOp::Remove, h, t);
+    retire(h);
+    publish_top();
+    return true;
+}
+
+template <class Backend>
+void BasicOrderBook<Backend>::retire(OrderHandle h)
+{
+    const OrderInfo *i = info.get(h);
+    by_created.erase({i->creation_time, h});
+    by_updated.erase({i->last_update_time, h});
+    orders.destroy(h);
+    info.destroy(h);
+    release_id(h);
+}
+
+// Release the id of an order that left the book. Inside apply_batch the release waits
+// for the end of the packet, so a later mutation of the same packet can add the id again
+// under its handle (cancel / re-add, a full fill followed by a new order).
+template <class Backend>
+void BasicOrderBook<Backend>::release_id(OrderHandle h)
+{
+    if (batching)
+        batch_released.push_back(h);
     else
-      return exe(ask_book);    
+        ids.release(h);
+}
+
+template <class Backend>
+void BasicOrderBook<Backend>::touch(OrderInfo *i, OrderHandle h, TimePoint t)
+{
+    // the freed node goes back to the pool and is taken again right away, and book stamps
+    // only grow, so the end hint makes the reinsertion O(1). (Not extract/insert: the
+    // node handle leaks its copy of the pool allocator on libstdc++ 12.)
+    by_updated.erase({i->last_update_time, h});
+    by_updated.emplace_hint(by_updated.end(), t, h);
+    i->last_update_time = t;
 }
 
 // Amend order: price and/or quantity. Behavior:
@@ -80,19 +265,41 @@ bool OrderBook::remove_order(const string &id, TimePoint t)
 // - If price same and quantity increases -> update quantity and last_update_time = t (priority changes).
 // - If price same and quantity decreases -> update quantity but KEEP priority (do not modify last_update_time nor re-order).
 // Returns true if amend succeeded.
-bool OrderBook::amend_order(const string &id, optional<double> new_price,
+template <class Backend>
+bool BasicOrderBook<Backend>::amend_order(const string &id, optional<Price> new_price,
                      optional<uint64_t> new_qty, TimePoint t)
 {
-    auto info_it = orders_by_id.find(id);
-    if (info_it == orders_by_id.end()) return false;
-    auto info = info_it->second;
-    auto o_shared = *info.list_it;
-    if (!o_shared) 
+    OB_TIME(Amend);
+    return amend_order(ids.find(id), new_price, new_qty, t);
+}
+
+template <class Backend>
+bool BasicOrderBook<Backend>::amend_order(OrderHandle h, optional<Price> new_price,
+                     optional<uint64_t> new_qty, TimePoint t)
+{
+    OB_TIME(Amend);
+    if (new_price.has_value() && !on_tick(*new_price))
+        return false;
+    if (new_qty == uint64_t(0))
+        return false; // resting orders always have quantity: cancel with remove_order
+
+    OrderNode *o = orders.find(h);
+    if (!o) 
         return false;
 
-    double old_price = info.price;
-    uint64_t old_qty = o_shared->quantity;
-    Side side = info.side;
+    return with_side(o->side, [&](auto &sb) { return amend_in(sb, o, new_price, new_qty, t); });
+}
+
+template <class Backend>
+template <class SB>
+bool BasicOrderBook<Backend>::amend_in(SB &sb, OrderNode *o, optional<Price> new_price, optional<uint64_t> new_qty,
+                                       TimePoint t)
+{
+    OrderHandle h = o->handle;
+    OrderInfo *oi = info.get(h);
+    constexpr Side side = SB::side;
+    Price old_price = o->level->price;
+    uint64_t old_qty = o->quantity;
 
     bool price_changed = new_price.has_value() && new_price.value() != old_price;
     bool qty_changed = new_qty.has_value() && new_qty.value() != old_qty;
@@ -101,258 +308,513 @@ bool OrderBook::amend_order(const string &id, optional<double> new_price,
     bool keep_priority = (!price_changed) && qty_changed &&
                          new_qty.value() < old_qty;
 
+    if (!price_changed && !qty_changed)
+        return false; // nothing to do
+    if (price_changed && !sb.fits(*new_price))
+        return false; // past the ladder's span
+    t = stamp(t);
+    journal_op(JournalOp::Amend, h, t, side,
+               uint8_t((new_price ? kJournalHasPrice : 0) | (new_qty ? kJournalHasQty : 0)),
+               new_price.value_or(Price()), new_qty.value_or(0));
+
     if (price_changed) 
     {
+        OB_RELABEL(AmendPrice);
         // Remove from old price level
-        // auto &pl_map_old = (side == Side::Bid) ? bid_book : ask_book;
-        auto exe = [&, this](auto &pl_map)
-        {
-            auto pl_it_old = pl_map.find(old_price);
-            if (pl_it_old != pl_map.end()) {
-                pl_it_old->second.orders.erase(info.list_it);
-                if (pl_it_old->second.orders.empty()) 
-                    pl_map.erase(pl_it_old);
-            }
+        unlink_order(sb, o);
 
-            // Update order fields
-            o_shared->price = new_price.value();
-            if (new_qty.has_value()) o_shared->quantity = new_qty.value();
-            o_shared->last_update_time = t;
-            o_shared->last_txn = {TxnType::Amend, t};
-
-            // Insert into new price level at the back (new update -> later update time -> lower priority)
-            //auto &pl_map_new = (side == Side::Bid) ? bid_book : ask_book;
-            auto pl_it_new = pl_map.find(o_shared->price);
-            if (pl_it_new == pl_map.end()) 
-            {
-                PriceLevel pl(o_shared->price);
-                auto inserted = pl_map.emplace(o_shared->price, move(pl)).first;
-                pl_it_new = inserted;
-            }
-            pl_it_new->second.orders.push_back(o_shared);
-            orders_by_id[id] = {side, o_shared->price, prev(pl_it_new->second.orders.end())};
-        };
-        
-        if(side == Side::Bid)
-            exe(bid_book);
-        else
-            exe(ask_book);
+        // Update order fields
+        if (new_qty.has_value()) o->quantity = new_qty.value();
+        touch(oi, h, t);
+        oi->last_txn = {TxnType::Amend, t};
 
+        // Insert into new price level at the back (new update -> later update time -> lower priority)
+        link_order(sb, o, new_price.value());
+        publish_top();
         return true;
     } 
     else 
     {
-        // price same
-        if (!qty_changed) return false; // nothing to do
-
+        // price same, quantity changed
+        PriceLevel *pl = o->level;
         if (keep_priority) 
         {
+            OB_RELABEL(AmendQtyDown);
             // reduce qty but keep priority; do not touch last_update_time or ordering
-            o_shared->quantity = new_qty.value();
-            o_shared->last_txn = {TxnType::Amend, t};
+            uint64_t by = old_qty - new_qty.value();
+            pl->reduce(o, by);
+            sb.totals.quantity -= by;
+            oi->last_txn = {TxnType::Amend, t};
             // last_update_time unchanged
+            publish_level(side, *pl, false);
+            publish_top();
             return true;
         } 
         else 
         {
+            OB_RELABEL(AmendQtyUp);
             // Either quantity increased or some other update that should change priority
             // We update last_update_time and move order to the back of its price level (later update time => lower priority)
-            //auto &pl_map = (side == Side::Bid) ? bid_book : ask_book;
-            auto exeCp = [&, this](auto &pl_map)
-            {
-                auto pl_it = pl_map.find(old_price);
-                if (pl_it == pl_map.end()) return false; // should not happen
-
-                // erase from current position and push_back (so it becomes later in ordering)
-                pl_it->second.orders.erase(info.list_it);
-                o_shared->quantity = new_qty.value();
-                o_shared->last_update_time = t;
-                o_shared->last_txn = {TxnType::Amend, t};
-                pl_it->second.orders.push_back(o_shared);
-                orders_by_id[id] = {side, old_price, prev(pl_it->second.orders.end())};
-                return true;
-            };
-            
-            if(side == Side::Bid)
-                return exeCp(bid_book);
-            else
-                return exeCp(ask_book);
-            
+            pl->requeue(o, new_qty.value());
+            touch(oi, h, t);
+            oi->last_txn = {TxnType::Amend, t};
+            sb.totals.quantity += o->quantity - old_qty;
+            publish_level(side, *pl, false);
+            publish_top();
+            return true;
         }
     } 
 }
 
 // Query whether book is crossed: top ask price <= top bid price
-bool OrderBook::is_crossed() const
+template <class Backend>
+bool BasicOrderBook<Backend>::is_crossed() const
 {
+    OB_TIME(Query);
     auto top_bid = top_price(Side::Bid);
     auto top_ask = top_price(Side::Ask);
     if (!top_bid.has_value() || !top_ask.has_value()) return false;
     return top_ask.value() <= top_bid.value();
 }
 // Top price for a side (empty => nullopt)
-std::optional<double> OrderBook::top_price(Side s) const
+template <class Backend>
+std::optional<Price> BasicOrderBook<Backend>::top_price(Side s) const
 {
-    if (s == Side::Bid) 
-    {
-        if (bid_book.empty()) return {};
-        return bid_book.begin()->first; // desc comparator -> begin() is highest
-    } 
-    else 
-    {
-        if (ask_book.empty()) return {};
-        return ask_book.begin()->first; // asc map -> begin() lowest
-    }
+    OB_TIME(Query);
+    // comparator puts the best level first: highest bid, lowest ask
+    return with_side(s, [](auto &sb) -> optional<Price> {
+        if (const PriceLevel *pl = sb.best()) return pl->price;
+        return nullopt;
+    });
 }
 
 // Bottom price for a side (empty => nullopt)
-std::optional<double> OrderBook::bottom_price(Side s) const
+template <class Backend>
+std::optional<Price> BasicOrderBook<Backend>::bottom_price(Side s) const
 {
-    if (s == Side::Bid) 
-    {
-        if (bid_book.empty()) return {};
-        return bid_book.rbegin()->first;
-    } 
-    else
-    {
-        if (ask_book.empty()) return {};
-        return ask_book.rbegin()->first;
-    }   
+    OB_TIME(Query);
+    return with_side(s, [](auto &sb) -> optional<Price> {
+        if (sb.levels.empty()) return nullopt;
+        return prev(sb.levels.end())->first;
+    });
 }
 // Number of price levels on a side
-size_t OrderBook::num_price_levels(Side s) const
+template <class Backend>
+size_t BasicOrderBook<Backend>::num_price_levels(Side s) const
 {
-    if(s == Side::Bid) 
-        return bid_book.size();
-    else 
-        return ask_book.size();    
+    OB_TIME(Query);
+    return with_side(s, [](auto &sb) { return sb.levels.size(); });
 }
 
 // Iterate price levels: returns vector of prices in priority order
-std::vector<double> OrderBook::price_levels(Side s) const
+template <class Backend>
+std::vector<Price> BasicOrderBook<Backend>::price_levels(Side s) const
 {
-    vector<double> res;
-    if (s == Side::Bid) 
-    {
-        for (const auto &kv : bid_book) res.push_back(kv.first);
-    } 
-    else 
-    {
-        for (const auto &kv : ask_book) res.push_back(kv.first);
-    }
+    OB_TIME(Query);
+    vector<Price> res;
+    res.reserve(num_price_levels(s));
+    for_each_level(s, [&](const PriceLevel &pl) { res.push_back(pl.price); });
     return res; 
 }
 
 // Number of orders at a price level
-size_t OrderBook::num_orders_at(Side s, double price) const
+template <class Backend>
+size_t BasicOrderBook<Backend>::num_orders_at(Side s, Price price) const
+{
+    OB_TIME(Query);
+    return with_side(s, [price](auto &sb) {
+        const PriceLevel *pl = sb.find(price);
+        return pl ? pl->order_count() : size_t(0);
+    });
+}
+// Iterate orders at a price level by priority (earliest update time first) -> returns vector of OrderRef
+template <class Backend>
+std::vector<OrderRef> BasicOrderBook<Backend>::orders_at(Side s, Price price) const
+{
+    OB_TIME(Query);
+    vector<OrderRef> res;
+    walk_level(s, price, [&](const OrderNode *o) {
+        res.push_back(ref(o));
+        return true;
+    });
+    return res;
+}
+// Total resting quantity at a price level
+template <class Backend>
+uint64_t BasicOrderBook<Backend>::quantity_at(Side s, Price price) const
+{
+    OB_TIME(Query);
+    return with_side(s, [price](auto &sb) {
+        const PriceLevel *pl = sb.find(price);
+        return pl ? pl->total_quantity() : uint64_t(0);
+    });
+}
+// Number of orders across all prices on a side
+template <class Backend>
+size_t BasicOrderBook<Backend>::num_orders_on_side(Side s) const
 {
-    auto exe = [&, this](auto &pl_map)
+    OB_TIME(Query);
+    return totals(s).orders;
+}
+// Total resting quantity across all prices on a side
+template <class Backend>
+uint64_t BasicOrderBook<Backend>::quantity_on_side(Side s) const
+{
+    OB_TIME(Query);
+    return totals(s).quantity;
+}
+template <class Backend>
+void BasicOrderBook<Backend>::journal_op(JournalOp op, OrderHandle h, TimePoint t, Side side, uint8_t flags,
+                                         Price price, uint64_t qty)
+{
+    if (!journal) return;
+    journal->append(make_journal_record(op, ids.id(h), time_to_ns(stamp(t)), uint8_t(side), flags, price.units, qty));
+}
+
+template <class Backend>
+void BasicOrderBook<Backend>::set_clock(BookClock c)
+{
+    clock_src = c;
+    if (c == BookClock::Tsc)
     {
-        auto it = pl_map.find(price);
-        if (it == pl_map.end()) 
-            return size_t(0);
-        return it->second.order_count();
-    };
-    if(s == Side::Bid)
-        return exe(bid_book);
-    else
-       return exe(ask_book);
+        // anchor the cycle counter to the wall clock once; stamps then cost one
+        // cycle_now() and a multiply
+        ns_per_cycle = 1.0 / cycles_per_ns();
+        tsc_base = cycle_now();
+        tsc_origin = now_tp();
+    }
 }
-// Iterate orders at a price level by priority (earliest update time first) -> returns vector of shared_ptr<Order>
-std::vector<shared_ptr<Order>> OrderBook::orders_at(Side s, double price) const
+
+template <class Backend>
+bool BasicOrderBook<Backend>::apply(const JournalRecord &r, vector<Fill> &fills)
 {
-    vector<shared_ptr<Order>> res;
-    auto exe = [&, this](auto &pl_map)
+    TimePoint t = r.time_ns == kJournalBookTime ? kBookTime : time_from_ns(r.time_ns);
+    Price price = Price::from_units(r.price_units);
+    switch (r.op)
     {
-        auto it = pl_map.find(price);
-        if (it == pl_map.end()) 
-          return;
-        for (auto &o : it->second.orders) 
-            res.push_back(o);
+        case JournalOp::Add:
+        {
+            OrderHandle h = ids.intern(r.order_id());
+            if (add_order(h, Side(r.side), price, r.quantity, t)) return true;
+            if (!is_live(h)) ids.release(h);
+            return false;
+        }
+        case JournalOp::AddMatch:
+        {
+            OrderHandle h = ids.intern(r.order_id());
+            auto res = add_and_match(h, Side(r.side), price, r.quantity, fills, t);
+            if (!res.accepted && !is_live(h)) ids.release(h);
+            return res.accepted;
+        }
+        case JournalOp::Amend:
+            return amend_order(ids.find(r.order_id()),
+                               (r.flags & kJournalHasPrice) ? optional<Price>(price) : nullopt,
+                               (r.flags & kJournalHasQty) ? optional<uint64_t>(r.quantity) : nullopt, t);
+        case JournalOp::Remove:
+            return remove_order(ids.find(r.order_id()), t);
+    }
+    return false;
+}
+
+static constexpr char kSnapshotMagic[8] = "OBSNAP1";
+
+template <class Backend>
+bool BasicOrderBook<Backend>::save_snapshot(const string &path) const
+{
+    SnapshotHeader hdr{};
+    memcpy(hdr.magic, kSnapshotMagic, sizeof hdr.magic);
+    hdr.price_decimals = OB_PRICE_DECIMALS;
+    hdr.tick_units = tick.units;
+    hdr.bid_orders = bids.totals.orders;
+    hdr.ask_orders = asks.totals.orders;
+
+    // serialise into one buffer, then a single write
+    vector<char> buf;
+    buf.reserve(sizeof hdr + (hdr.bid_orders + hdr.ask_orders) * (sizeof(SnapshotOrder) + 16));
+    auto put = [&buf](const void *p, size_t n) {
+        buf.insert(buf.end(), static_cast<const char *>(p), static_cast<const char *>(p) + n);
     };
-    if( s == Side::Bid)
-        exe(bid_book);
+    put(&hdr, sizeof hdr);
+    for (Side s : {Side::Bid, Side::Ask})
+        for_each_order_on_side(s, [&](const Order &o) {
+            SnapshotOrder e{};
+            e.price_units = o.price.units;
+            e.quantity = o.quantity;
+            e.created_ns = time_to_ns(o.creation_time);
+            e.updated_ns = time_to_ns(o.last_update_time);
+            e.txn_ns = time_to_ns(o.last_txn.time);
+            e.txn_type = uint8_t(o.last_txn.type);
+            e.id_len = uint32_t(o.id.size());
+            put(&e, sizeof e);
+            put(o.id.data(), o.id.size());
+        });
+
+    FILE *f = fopen(path.c_str(), "wb");
+    if (!f) return false;
+    bool ok = fwrite(buf.data(), 1, buf.size(), f) == buf.size();
+    return (fclose(f) == 0) && ok;
+}
+
+template <class Backend>
+bool BasicOrderBook<Backend>::load_snapshot(const string &path)
+{
+    if (bids.totals.orders || asks.totals.orders)
+        return false;
+
+    vector<char> buf;
+    FILE *f = fopen(path.c_str(), "rb");
+    if (!f) return false;
+    bool read_ok = fseek(f, 0, SEEK_END) == 0;
+    long size = read_ok ? ftell(f) : -1;
+    if (size >= 0 && fseek(f, 0, SEEK_SET) == 0)
+    {
+        buf.resize(size_t(size));
+        read_ok = fread(buf.data(), 1, buf.size(), f) == buf.size();
+    }
     else
-        exe(ask_book);
-        
-    return res;
+        read_ok = false;
+    fclose(f);
+
+    SnapshotHeader hdr;
+    if (!read_ok || buf.size() < sizeof hdr) return false;
+    memcpy(&hdr, buf.data(), sizeof hdr);
+    if (memcmp(hdr.magic, kSnapshotMagic, sizeof hdr.magic) != 0 || hdr.price_decimals != OB_PRICE_DECIMALS ||
+        hdr.tick_units != tick.units)
+        return false;
+
+    // Entry at pos (bounds-checked); advances pos past the id
+    size_t pos = sizeof hdr;
+    auto next = [&](SnapshotOrder &e, string_view &id) {
+        if (buf.size() - pos < sizeof e) return false;
+        memcpy(&e, buf.data() + pos, sizeof e);
+        pos += sizeof e;
+        if (buf.size() - pos < e.id_len) return false;
+        id = string_view(buf.data() + pos, e.id_len);
+        pos += e.id_len;
+        return true;
+    };
+
+    // Single pass: entries are validated as they are loaded, and a bad entry rolls the
+    // book back to empty. Each side arrives in priority order, so a new level always goes
+    // at the end of its side and each order at the back of the current level.
+    uint64_t total = hdr.bid_orders + hdr.ask_orders;
+    if (hdr.bid_orders > buf.size() || total > (buf.size() - pos) / sizeof(SnapshotOrder))
+        return false; // counts that can't fit in the file
+    vector<pair<TimePoint, OrderHandle>> created, updated;
+    created.reserve(total);
+    updated.reserve(total);
+    ids.reserve(total);
+    TimePoint latest{}; // book stamps after the load continue from here
+    auto load_side = [&](auto &sb, uint64_t n) {
+        using SB = decay_t<decltype(sb)>;
+        constexpr Side s = SB::side;
+        PriceLevel *level = nullptr;
+        for (uint64_t i = 0; i < n; ++i)
+        {
+            SnapshotOrder e;
+            string_view id;
+            if (!next(e, id)) return false;
+            Price p = Price::from_units(e.price_units);
+            if (!on_tick(p) || !sb.fits(p) || e.quantity == 0 || e.txn_type > uint8_t(TxnType::Fill) ||
+                (journal && id.size() > kJournalMaxId))
+                return false;
+            // levels best first, so prices never improve along a side
+            if (level && SB::better(p, level->price))
+                return false;
+            OrderHandle h = ids.intern(id);
+            if (is_live(h)) return false; // duplicate id
+
+            OrderNode *o = orders.construct(h, h, s, e.quantity);
+            OrderInfo *oi = info.construct(h, ids.id(h), time_from_ns(e.created_ns));
+            oi->last_update_time = time_from_ns(e.updated_ns);
+            oi->last_txn = {TxnType(e.txn_type), time_from_ns(e.txn_ns)};
+            latest = max({latest, oi->creation_time, oi->last_update_time, oi->last_txn.time});
+            if (!level || level->price != p)
+                level = &sb.levels.emplace_hint(sb.levels.end(), p, PriceLevel(p))->second;
+            level->push_back(o);
+            ++sb.totals.orders;
+            sb.totals.quantity += o->quantity;
+            created.emplace_back(oi->creation_time, h);
+            updated.emplace_back(oi->last_update_time, h);
+        }
+        return true;
+    };
+    if (!load_side(bids, hdr.bid_orders) || !load_side(asks, hdr.ask_orders) ||
+        pos != buf.size())
+    {
+        for (auto &ch : created)
+        {
+            orders.destroy(ch.second);
+            info.destroy(ch.second);
+            ids.release(ch.second);
+        }
+        bids = decltype(bids)(tick);
+        asks = decltype(asks)(tick);
+        return false;
+    }
+
+    // sorted input builds the time indexes in linear time
+    sort(created.begin(), created.end());
+    sort(updated.begin(), updated.end());
+    by_created.insert(created.begin(), created.end());
+    by_updated.insert(updated.begin(), updated.end());
+    if (latest > last_stamp) last_stamp = latest;
+
+    publish_top();
+    return true;
 }
-// Number of orders across all prices on a side
-size_t OrderBook::num_orders_on_side(Side s) const
+
+template <class Backend>
+void BasicOrderBook<Backend>::enable_l2_feed(size_t capacity)
 {
-    size_t cnt = 0;
-    if (s == Side::Bid) {
-        for (auto &kv : bid_book) cnt += kv.second.order_count();
-    } else {
-        for (auto &kv : ask_book) cnt += kv.second.order_count();
+    l2.reset(capacity); // last_top is always current, so the feed starts from it
+}
+
+// Best level of a side as a summary (all zero if the side is empty)
+template <class Backend>
+LevelSummary BasicOrderBook<Backend>::best_level(Side s) const
+{
+    return with_side(s, [](auto &sb) {
+        const PriceLevel *pl = sb.best();
+        return pl ? LevelSummary{pl->price, pl->quantity, uint32_t(pl->count)} : LevelSummary{};
+    });
+}
+
+// If either side's best level changed since the last call, publish the new BBO and
+// push a TopOfBook event for each changed side (once, at the end of a batch)
+template <class Backend>
+void BasicOrderBook<Backend>::publish_top()
+{
+    if (batching) return;
+    bool changed = false;
+    for (Side s : {Side::Bid, Side::Ask})
+    {
+        LevelSummary now = best_level(s);
+        LevelSummary &last = last_top[int(s)];
+        if (now.price == last.price && now.quantity == last.quantity && now.count == last.count)
+            continue;
+        last = now;
+        changed = true;
+        if (l2.enabled()) l2.push({L2Event::TopOfBook, s, now});
     }
-    return cnt;   
+    if (changed) bbo_pub.store(Bbo{last_top[int(Side::Bid)], last_top[int(Side::Ask)]});
 }
+
+// Top max_levels levels of a side from the cached per-level aggregates
+template <class Backend>
+size_t BasicOrderBook<Backend>::depth(Side s, LevelSummary *out, size_t max_levels) const
+{
+    OB_TIME(Query);
+    size_t n = 0;
+    if (max_levels == 0) return 0;
+    for_each_level(s, [&](const PriceLevel &pl) {
+        out[n++] = {pl.price, pl.quantity, uint32_t(pl.count)};
+        return n < max_levels;
+    });
+    return n;
+}
+
 // Iterate orders across all prices on a side by priority (price priority then update time)
-std::vector<shared_ptr<Order>> OrderBook::orders_on_side(Side s) const
-{
-    vector<shared_ptr<Order>> res;
-    if (s == Side::Bid) {
-        for (auto &kv : bid_book)
-            for (auto &o : kv.second.orders) res.push_back(o);
-    } else {
-        for (auto &kv : ask_book)
-            for (auto &o : kv.second.orders) res.push_back(o);
-    }
+template <class Backend>
+std::vector<OrderRef> BasicOrderBook<Backend>::orders_on_side(Side s) const
+{
+    OB_TIME(Query);
+    vector<OrderRef> res;
+    res.reserve(totals(s).orders);
+    walk_side(s, [&](const OrderNode *o) {
+        res.push_back(ref(o));
+        return true;
+    });
     return res;  
 }
 // Get order info by id
-std::optional<shared_ptr<Order>> OrderBook::get_order(const string &id) const
+template <class Backend>
+std::optional<OrderRef> BasicOrderBook<Backend>::get_order(const string &id) const
+{
+    OB_TIME(Query);
+    return get_order(ids.find(id));
+}
+template <class Backend>
+std::optional<OrderRef> BasicOrderBook<Backend>::get_order(OrderHandle h) const
 {
-    auto it = orders_by_id.find(id);
-    if (it == orders_by_id.end()) 
+    OB_TIME(Query);
+    auto *o = orders.find(h);
+    if (!o) 
      return {};
-    return *it->second.list_it;   
+    return ref(o);
 }
 // Last transaction on order id (if exists)
-std::optional<Transaction> OrderBook::last_transaction(const string &id) const
+template <class Backend>
+std::optional<Transaction> BasicOrderBook<Backend>::last_transaction(const string &id) const
 {
-    auto o = get_order(id);
-    if (o.has_value()) return (*o)->last_txn;
-    // If removed, we do not keep history except possibly in the removed shared_ptr that got destroyed.
+    OB_TIME(Query);
+    return last_transaction(ids.find(id));
+}
+template <class Backend>
+std::optional<Transaction> BasicOrderBook<Backend>::last_transaction(OrderHandle h) const
+{
+    OB_TIME(Query);
+    if (orders.find(h)) return info.get(h)->last_txn; // cold data only
+    // If removed, we do not keep history: the pooled slot is released with the order.
     return {};
 }
 // Iterate orders created before/after given time (across entire book)
-std::vector<shared_ptr<Order>> OrderBook::orders_created_before(TimePoint t) const
+template <class Backend>
+std::vector<OrderRef> BasicOrderBook<Backend>::orders_created_before(TimePoint t) const
 {
-   vector<shared_ptr<Order>> res;
-    for (const auto &kv : orders_by_id) {
-        if (auto o = *kv.second.list_it)
-            if (o->creation_time < t) res.push_back(o);
-    }
-    return res; 
+    OB_TIME(Query);
+    vector<OrderRef> res;
+    walk_times(by_created.begin(), by_created.lower_bound({t, 0}), [&](const OrderNode *o) {
+        res.push_back(ref(o));
+        return true;
+    });
+    return res;
 }
-std::vector<shared_ptr<Order>> OrderBook::orders_created_after(TimePoint t) const
+template <class Backend>
+std::vector<OrderRef> BasicOrderBook<Backend>::orders_created_after(TimePoint t) const
 {
-    vector<shared_ptr<Order>> res;
-    for (const auto &kv : orders_by_id) {
-        if (auto o = *kv.second.list_it)
-            if (o->creation_time > t) res.push_back(o);
-    }
+    OB_TIME(Query);
+    vector<OrderRef> res;
+    walk_times(by_created.upper_bound({t, kInvalidHandle}), by_created.end(), [&](const OrderNode *o) {
+        res.push_back(ref(o));
+        return true;
+    });
     return res;
 }
-std::vector<shared_ptr<Order>> OrderBook::orders_updated_before(TimePoint t) const
+template <class Backend>
+std::vector<OrderRef> BasicOrderBook<Backend>::orders_updated_before(TimePoint t) const
 {
-    vector<shared_ptr<Order>> res;
-    for (const auto &kv : orders_by_id) {
-        if (auto o = *kv.second.list_it)
-            if (o->last_update_time < t) res.push_back(o);
-    }
-    return res; 
+    OB_TIME(Query);
+    vector<OrderRef> res;
+    walk_times(by_updated.begin(), by_updated.lower_bound({t, 0}), [&](const OrderNode *o) {
+        res.push_back(ref(o));
+        return true;
+    });
+    return res;
 }
-std::vector<shared_ptr<Order>> OrderBook::orders_updated_after(TimePoint t) const
+template <class Backend>
+std::vector<OrderRef> BasicOrderBook<Backend>::orders_updated_after(TimePoint t) const
 {
-    vector<shared_ptr<Order>> res;
-    for (const auto &kv : orders_by_id) {
-        if (auto o = *kv.second.list_it)
-            if (o->last_update_time > t) res.push_back(o);
-    }
+    OB_TIME(Query);
+    vector<OrderRef> res;
+    walk_times(by_updated.upper_bound({t, kInvalidHandle}), by_updated.end(), [&](const OrderNode *o) {
+        res.push_back(ref(o));
+        return true;
+    });
     return res;
 }
 
-}
\ No newline at end of file
+template <class Backend>
+void BasicOrderBook<Backend>::dump_latency(ostream &os) const
+{
+#ifdef OB_INSTRUMENT
+    lat.dump(os, book_op_name);
+#else
+    os << "latency instrumentation disabled (build with -DOB_INSTRUMENT)\n";
+#endif
+}
+
+template class BasicOrderBook<MapBackend>;
+template class BasicOrderBook<LadderBackend>;
+
+}
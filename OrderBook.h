@@ -1,22 +1,37 @@
+#pragma once
 #include <algorithm>
+#include <array>
 #include <chrono>
 #include <ctime>
 #include <functional>
 #include <iostream>
-#include <list>
 #include <map>
 #include <memory>
 #include <optional>
+#include <set>
 #include <string>
+#include <string_view>
+#include <type_traits>
 #include <unordered_map>
 #include <vector>
 
+#include "EventRing.h"
+#include "IdInterner.h"
+#include "Journal.h"
+#include "LatencyHistogram.h"
+#include "NodePool.h"
+#include "Price.h"
+#include "PriceLadder.h"
+#include "Seqlock.h"
+#include "SlabPool.h"
+#include "Snapshot.h"
+
 
 using namespace std;
 using TimePoint = chrono::system_clock::time_point;
 
-static TimePoint now_tp() { return chrono::system_clock::now(); }
-static string time_to_string(TimePoint t) 
+inline TimePoint now_tp() { return chrono::system_clock::now(); }
+inline string time_to_string(TimePoint t)
 {
     auto tt = chrono::system_clock::to_time_t(t);
     char buf[64];
@@ -30,126 +45,733 @@ static string time_to_string(TimePoint t)
 namespace ob
 {
 enum class Side { Bid, Ask };
-enum class TxnType { Add, Amend, Remove };
+enum class TxnType { Add, Amend, Remove, Fill };
 
 struct Transaction {
     TxnType type;
     TimePoint time;
 };
 
+// Default TimePoint argument of the mutations: "stamp this with the book's clock".
+// The clock is only read when the call actually records a time.
+constexpr TimePoint kBookTime = TimePoint::min();
+
+// Where a book's own timestamps come from (BasicOrderBook::set_clock)
+enum class BookClock : uint8_t {
+    System,   // system_clock::now() per stamp (default)
+    Tsc,      // cycle counter, scaled to wall time from an anchor taken by set_clock()
+    Caller,   // the time last passed to set_time(), e.g. one timestamp per feed packet
+    Sequence, // no clock at all: each stamp is one tick after the previous one
+};
+
+struct PriceLevel;
+
+// Hot part of a resting order: everything matching, depth and queue walks read.
+// Pooled by handle (40 bytes, so queue walks touch little more than the links);
+// the rest of the order lives in the parallel OrderInfo slot of the same handle.
+struct OrderNode {
+    uint64_t quantity;
+    // Intrusive links in the owning PriceLevel's queue (prev = higher priority)
+    OrderNode *prev = nullptr;
+    OrderNode *next = nullptr;
+    // Level the order is queued on (set by PriceLevel::push_back). Level storage is
+    // address-stable in both backends, so cancels and amends skip the price lookup.
+    // The order's price is level->price.
+    PriceLevel *level = nullptr;
+    OrderHandle handle;
+    Side side;
+
+    OrderNode(OrderHandle handle_, Side side_, uint64_t qty_) : quantity(qty_), handle(handle_), side(side_) {}
+};
+
+// Cold part of a resting order: identity and history, read by queries and snapshots
+struct OrderInfo {
+    string_view id;     // interned by the book; see IdInterner::id() for lifetime
+    TimePoint creation_time;
+    TimePoint last_update_time;
+    Transaction last_txn;
+
+    OrderInfo(string_view id_, TimePoint now)
+        : id(id_), creation_time(now), last_update_time(now), last_txn{TxnType::Add, now} {}
+};
+
+// A resting order as seen through the query API: a by-value view assembled from its
+// OrderNode and OrderInfo
 struct Order {
-    string id;
+    string_view id;
+    OrderHandle handle;
     Side side;
-    double price;
+    Price price;
     uint64_t quantity;
     TimePoint creation_time;
     TimePoint last_update_time;
     Transaction last_txn;
 
-    Order(string id_, Side side_, double price_, uint64_t qty_,
-          TimePoint now = now_tp())
-        : id(move(id_)),
-          side(side_),
-          price(price_),
-          quantity(qty_),
-          creation_time(now),
-          last_update_time(now),
-          last_txn{TxnType::Add, now} {}
-
+    Order(const OrderNode &n, const OrderInfo &i);
     string side_str() const { return side == Side::Bid ? "Bid" : "Ask"; }
 };
 
+// Non-owning reference to an order resting on the book. Valid until the order is
+// removed or fully filled (its pooled slots are then reused by a later add).
+// ref->field reads the live order through a temporary Order view.
+class OrderRef {
+   public:
+    OrderRef(const OrderNode *n, const OrderInfo *i) : n(n), i(i) {}
+    Order operator*() const { return Order(*n, *i); }
+    struct Arrow {
+        Order view;
+        const Order *operator->() const { return &view; }
+    };
+    Arrow operator->() const { return {**this}; }
+    OrderHandle handle() const { return n->handle; }
+
+   private:
+    const OrderNode *n;
+    const OrderInfo *i;
+};
+
 // A price level maintains orders in priority order (earliest last_update_time first)
+// as an intrusive doubly-linked queue threaded through the pooled Orders.
 struct PriceLevel {
-    double price;
-    list<shared_ptr<Order>> orders; // maintained in priority order by last_update_time
-    explicit PriceLevel(double p) : price(p) {}
-    size_t order_count() const { return orders.size(); }
-    uint64_t total_quantity() const {
-        uint64_t s = 0;
-        for (auto &o : orders) s += o->quantity;
-        return s;
+    Price price;
+    OrderNode *head = nullptr; // highest priority
+    OrderNode *tail = nullptr; // lowest priority
+    size_t count = 0;
+    uint64_t quantity = 0; // sum of resting quantity, kept up to date by every change
+
+    explicit PriceLevel(Price p) : price(p) {}
+    size_t order_count() const { return count; }
+    bool empty() const { return head == nullptr; }
+    uint64_t total_quantity() const { return quantity; }
+
+    // Append at the back of the queue (lowest priority)
+    void push_back(OrderNode *o) {
+        o->prev = tail;
+        o->next = nullptr;
+        if (tail) tail->next = o; else head = o;
+        tail = o;
+        o->level = this;
+        ++count;
+        quantity += o->quantity;
+    }
+    // Unlink from anywhere in the queue
+    void erase(OrderNode *o) {
+        if (o->prev) o->prev->next = o->next; else head = o->next;
+        if (o->next) o->next->prev = o->prev; else tail = o->prev;
+        o->prev = o->next = nullptr;
+        o->level = nullptr;
+        --count;
+        quantity -= o->quantity;
+    }
+    // Set a resting order's quantity and move it to the back of the queue (priority
+    // lost), relinking it in place without leaving the level
+    void requeue(OrderNode *o, uint64_t qty) {
+        quantity += qty - o->quantity;
+        o->quantity = qty;
+        if (o == tail) return;
+        if (o->prev) o->prev->next = o->next; else head = o->next;
+        o->next->prev = o->prev;
+        o->prev = tail;
+        o->next = nullptr;
+        tail->next = o;
+        tail = o;
+    }
+    // Reduce a resting order's quantity in place (keeps its priority)
+    void reduce(OrderNode *o, uint64_t by) {
+        o->quantity -= by;
+        quantity -= by;
     }
 };
 
+inline Order::Order(const OrderNode &n, const OrderInfo &i)
+    : id(i.id),
+      handle(n.handle),
+      side(n.side),
+      price(n.level->price),
+      quantity(n.quantity),
+      creation_time(i.creation_time),
+      last_update_time(i.last_update_time),
+      last_txn(i.last_txn) {}
+
 // Comparator for bid side (highest price first)
 struct DescPrice {
-    bool operator()(double a, double b) const { return a > b; }
+    static constexpr bool descending = true;
+    bool operator()(Price a, Price b) const { return a > b; }
 };
 
 // Comparator for ask side (lowest price first) -- std::less is default
 struct AscePrice {
-    bool operator()(double a, double b) const { return a < b; }
+    static constexpr bool descending = false;
+    bool operator()(Price a, Price b) const { return a < b; }
+};
+
+// One execution against a resting order, produced by add_and_match
+struct Fill {
+    OrderHandle maker;        // resting order that was hit
+    string_view maker_id;     // valid until the maker's handle is reused by a later add
+    Price price;              // execution price (the maker's level)
+    uint64_t quantity;
+    uint64_t maker_remaining; // 0 => the maker was fully filled and left the book
+};
+
+// Outcome of add_and_match
+struct MatchResult {
+    bool accepted;       // false if the id already exists
+    uint64_t filled;     // quantity executed against the opposite side
+    uint64_t resting;    // quantity left resting on the book (0 if fully filled)
+};
+
+// One market-by-price (L2) level: aggregate quantity and order count at a price
+struct LevelSummary {
+    Price price;
+    uint64_t quantity;
+    uint32_t count;
+};
+
+// Top-N levels per side in caller-owned fixed storage, best level first.
+// Filled by BasicOrderBook::depth(); only the first bid_levels/ask_levels entries are set.
+template <size_t N>
+struct DepthSnapshot {
+    array<LevelSummary, N> bids;
+    array<LevelSummary, N> asks;
+    size_t bid_levels = 0;
+    size_t ask_levels = 0;
+};
+
+// One mutation of a batch (BasicOrderBook::apply_batch), addressed by handle.
+// Add/AddMatch use side, price and quantity; Amend uses flags (kJournalHasPrice /
+// kJournalHasQty) to say which of price and quantity are given; Remove only the handle.
+struct BookMutation {
+    OrderHandle handle;
+    JournalOp op;
+    Side side;
+    uint8_t flags;
+    Price price;
+    uint64_t quantity;
+};
+
+// Best bid and offer as published for other threads (BasicOrderBook::bbo()).
+// An empty side has count 0.
+struct Bbo {
+    LevelSummary bid;
+    LevelSummary ask;
+
+    bool crossed() const { return bid.count && ask.count && bid.price >= ask.price; }
+};
+
+// Incremental L2 feed event, pushed by book mutations while the feed is enabled.
+// NewLevel/LevelChanged carry the level's new aggregates, LevelDeleted its price with
+// zero quantity and count. TopOfBook follows the level events of any mutation that
+// changed a side's best level (price, quantity or count); an empty side has count 0.
+enum class L2Event : uint8_t { NewLevel, LevelChanged, LevelDeleted, TopOfBook };
+
+struct L2Update {
+    L2Event type;
+    Side side;
+    LevelSummary level;
+};
+
+// Operation kinds timed when built with -DOB_INSTRUMENT.
+// Amend is an amend rejected before its path was known (unknown id, off-tick, no-op).
+// Batch is a whole apply_batch call (the mutations inside it are not timed separately).
+enum class BookOp { Add, AddMatch, Remove, Amend, AmendPrice, AmendQtyUp, AmendQtyDown, Query, Batch, Count };
+
+// Latency hooks used by the OrderBook methods: compiled out unless built with -DOB_INSTRUMENT.
+// A relabel inside apply_batch is skipped: the sample belongs to the whole Batch.
+#ifdef OB_INSTRUMENT
+#define OB_TIME(op) LatencyScope<BookOp> latency_scope(lat, BookOp::op)
+#define OB_RELABEL(op) (batching ? void() : lat.relabel(BookOp::op))
+#else
+#define OB_TIME(op) (void)0
+#define OB_RELABEL(op) (void)0
+#endif
+
+inline const char *book_op_name(BookOp op)
+{
+    static const char *names[] = {"add", "add_and_match", "remove", "amend (rejected)",
+                                  "amend price", "amend qty up", "amend qty down", "query", "batch"};
+    return names[size_t(op)];
+}
+
+// Level storage backends. Both keep the same OrderBook API so they can be A/B tested.
+// MapBackend: node-based std::map keyed by price (O(log N) level lookup).
+// LadderBackend: contiguous tick-indexed array (O(1) level lookup), see PriceLadder.h.
+struct MapBackend {
+    template <class Cmp> using levels = map<Price, PriceLevel, Cmp>;
+    template <class Levels> static Levels make(Price /*tick_size*/) { return Levels{}; }
+    template <class Levels> static bool fits(const Levels &, Price) { return true; }
+};
+
+struct LadderBackend {
+    template <class Cmp> using levels = PriceLadder<PriceLevel, Cmp>;
+    template <class Levels> static Levels make(Price tick_size) { return Levels(tick_size); }
+    template <class Levels> static bool fits(const Levels &l, Price p) { return l.fits(p); }
+};
+
+// Running totals of one side, updated incrementally by every mutation
+struct SideTotals {
+    size_t orders = 0;
+    uint64_t quantity = 0;
 };
 
-class OrderBook 
+// One side of the book with its direction fixed at compile time. S picks the level
+// comparator (bids best = highest), so level lookups inline it and the price tests
+// below compile to a single comparison. BasicOrderBook holds one per side and branches
+// on the runtime Side once per call (with_side); everything below that is side-free.
+template <Side S, class Backend>
+struct SideBook {
+    static constexpr Side side = S;
+    using Compare = conditional_t<S == Side::Bid, DescPrice, AscePrice>;
+    using Levels = typename Backend::template levels<Compare>;
+
+    explicit SideBook(Price tick_size) : levels(Backend::template make<Levels>(tick_size)) {}
+
+    // a is a better price than b on this side
+    static bool better(Price a, Price b) { return Compare()(a, b); }
+    // An opposite-side order limited at `limit` trades with a level at `level`
+    static bool crossed_by(Price level, Price limit) { return !better(limit, level); }
+
+    // Level at price p, created empty if missing
+    PriceLevel &level_at(Price p, bool &created)
+    {
+        auto it = levels.find(p);
+        created = it == levels.end();
+        if (created) it = levels.emplace(p, PriceLevel(p)).first;
+        return it->second;
+    }
+    const PriceLevel *find(Price p) const
+    {
+        auto it = levels.find(p);
+        return it == levels.end() ? nullptr : &it->second;
+    }
+    const PriceLevel *best() const { return levels.empty() ? nullptr : &levels.begin()->second; }
+    // The level storage can take a level at p (the ladder caps its price span)
+    bool fits(Price p) const { return Backend::fits(levels, p); }
+
+    Levels levels;
+    SideTotals totals;
+};
+
+template <class Backend>
+class BasicOrderBook 
 {
    public:
-    OrderBook() = default;
+    // Prices passed to the book must be a multiple of tick_size (per instrument).
+    // Doubles convert to Price at the call site; everything inside runs on integer ticks.
+    // A tick that rounds to zero or below at OB_PRICE_DECIMALS (0.00001 at 4 decimals) is
+    // clamped to one price unit; tick_size() reports the tick actually in force.
+    explicit BasicOrderBook(Price tick_size = 0.01)
+        : tick(valid_tick(tick_size)), bids(tick), asks(tick) {}
 
-    // Add an order. Assumes id unique.
-    bool add_order(const string &id, Side side, double price, uint64_t qty, TimePoint t = now_tp());
+    Price tick_size() const { return tick; }
+
+    // ID interning: external ids map once to a dense handle. The handle overloads below
+    // skip string hashing entirely. A handle names its id until the order leaves the
+    // book (removed or fully filled); after that it may be reused for another id.
+    OrderHandle intern(const string &id) { return ids.intern(id); }
+    // Handle of an id already known to the book (kInvalidHandle if none)
+    OrderHandle find_handle(const string &id) const { return ids.find(id); }
+    string_view order_id(OrderHandle h) const { return ids.id(h); }
+
+    // Journal every successful add / add_and_match / amend / remove (with its TimePoint)
+    // to w, which must be open; nullptr detaches. Non-owning. While a journal is
+    // attached, ids longer than kJournalMaxId are rejected.
+    void attach_journal(JournalWriter *w) { journal = w; }
+    // Re-apply one journal record (replay). Returns what the original call returned.
+    bool apply(const JournalRecord &r, vector<Fill> &fills);
+
+    // Point-in-time snapshot (format in Snapshot.h): every order in priority order with
+    // its times and last_txn. load_snapshot bulk-loads into a book with no resting orders
+    // and the same tick size, appending levels and queues in sorted order instead of
+    // replaying adds. The load is not journalled; with the L2 feed on it only emits
+    // TopOfBook events. Both return false on I/O error, load also on a malformed or
+    // incompatible file, in which case the book is left unchanged.
+    bool save_snapshot(const string &path) const;
+    bool load_snapshot(const string &path);
+
+    // Timestamps. Every mutation takes an optional TimePoint; an explicit one is recorded
+    // as given (replay, tests), the kBookTime default is stamped by the book's clock.
+    // Book stamps are strictly increasing per book whatever the source: a reading that
+    // repeats or goes back (equal Caller times, a wall-clock step) is bumped to one tick
+    // after the latest time the book has recorded. So stamps double as an arrival
+    // sequence and never invert the time indexes. Remove only reads the clock while a
+    // journal is attached. Queue priority itself is the FIFO order of each level.
+    void set_clock(BookClock c);
+    BookClock clock() const { return clock_src; }
+    // Time for BookClock::Caller stamps until the next set_time
+    void set_time(TimePoint t) { caller_time = t; }
+
+    // Add an order. Assumes id unique. Fails if qty is 0, if price is off the tick grid
+    // or, on a LadderOrderBook, would spread its side over more than
+    // PriceLadder::kMaxSpanTicks (the same holds for add_and_match and amends).
+    bool add_order(const string &id, Side side, Price price, uint64_t qty, TimePoint t = kBookTime);
+    bool add_order(OrderHandle h, Side side, Price price, uint64_t qty, TimePoint t = kBookTime);
+
+    // Add an order and match it against the opposite side in price-time priority.
+    // Crosses levels best-first and orders FIFO within a level; makers that are fully
+    // filled are removed, partially filled makers keep their priority. Any remainder
+    // rests at `price`. `fills` is cleared and refilled; reuse it across calls so no
+    // allocation happens per fill once its capacity has grown.
+    MatchResult add_and_match(const string &id, Side side, Price price, uint64_t qty,
+                              vector<Fill> &fills, TimePoint t = kBookTime);
+    MatchResult add_and_match(OrderHandle h, Side side, Price price, uint64_t qty,
+                              vector<Fill> &fills, TimePoint t = kBookTime);
+
+    // Apply n mutations in order, for feeds that arrive in packets. An explicit t stamps
+    // every mutation with t; by default the clock is read once and each accepted mutation
+    // is stamped one tick after the previous, so book stamps stay strictly increasing.
+    // Each behaves like the matching handle call, but the per-call overhead is paid once
+    // per batch: one clock read, one BBO / TopOfBook publish at the end (level events are
+    // still emitted per mutation) and one latency sample. Order slots and levels of
+    // upcoming mutations are prefetched while the current one runs. Fills of AddMatch
+    // mutations are appended to `fills` (cleared first); ok[i], if given, receives each
+    // mutation's result. Ids of orders that leave the book stay interned until the end
+    // of the packet, so a packet may cancel an id and add it again under the same handle.
+    // Returns the number of mutations accepted.
+    size_t apply_batch(const BookMutation *cmds, size_t n, vector<Fill> &fills, bool *ok = nullptr,
+                       TimePoint t = kBookTime);
 
     // Remove an order by id
-    bool remove_order(const string &id, TimePoint t = now_tp());
+    bool remove_order(const string &id, TimePoint t = kBookTime);
+    bool remove_order(OrderHandle h, TimePoint t = kBookTime);
 
     // Amend order: price and/or quantity. Behavior:
     // - If price changes -> order gets reinserted at new price level and its last_update_time becomes t.
     // - If price same and quantity increases -> update quantity and last_update_time = t (priority changes).
     // - If price same and quantity decreases -> update quantity but KEEP priority (do not modify last_update_time nor re-order).
-    // Returns true if amend succeeded.
-    bool amend_order(const string &id, optional<double> new_price,
-                     optional<uint64_t> new_qty, TimePoint t = now_tp());
+    // Returns true if amend succeeded (a new price must be on the tick grid, a new quantity
+    // non-zero: cancel with remove_order).
+    bool amend_order(const string &id, optional<Price> new_price,
+                     optional<uint64_t> new_qty, TimePoint t = kBookTime);
+    bool amend_order(OrderHandle h, optional<Price> new_price,
+                     optional<uint64_t> new_qty, TimePoint t = kBookTime);
 
     // Query whether book is crossed: top ask price <= top bid price
     bool is_crossed() const;
     // Top price for a side (empty => nullopt)
-    optional<double> top_price(Side s) const;
+    optional<Price> top_price(Side s) const;
 
     // Bottom price for a side (empty => nullopt)
-    optional<double> bottom_price(Side s) const;
+    optional<Price> bottom_price(Side s) const;
 
     // Number of price levels on a side
     size_t num_price_levels(Side s) const;
 
     // Iterate price levels: returns vector of prices in priority order
-    vector<double> price_levels(Side s) const;
+    vector<Price> price_levels(Side s) const;
 
     // Number of orders at a price level
-    size_t num_orders_at(Side s, double price) const;
+    size_t num_orders_at(Side s, Price price) const;
+
+    // Iterate orders at a price level by priority (earliest update time first) -> returns vector of OrderRef
+    vector<OrderRef> orders_at(Side s, Price price) const;
 
-    // Iterate orders at a price level by priority (earliest update time first) -> returns vector of shared_ptr<Order>
-    vector<shared_ptr<Order>> orders_at(Side s, double price) const;
+    // Total resting quantity at a price level (O(1), cached on the level)
+    uint64_t quantity_at(Side s, Price price) const;
 
-    // Number of orders across all prices on a side
+    // Number of orders across all prices on a side (O(1), cached)
     size_t num_orders_on_side(Side s) const ;
 
+    // Total resting quantity across all prices on a side (O(1), cached)
+    uint64_t quantity_on_side(Side s) const;
+
     // Iterate orders across all prices on a side by priority (price priority then update time)
-    vector<shared_ptr<Order>> orders_on_side(Side s) const;
+    vector<OrderRef> orders_on_side(Side s) const;
+
+    // L2 depth: write up to max_levels level summaries of a side into out, best first.
+    // O(levels written) from the cached level aggregates; no allocation. Returns the count.
+    size_t depth(Side s, LevelSummary *out, size_t max_levels) const;
+    template <size_t N>
+    void depth(DepthSnapshot<N> &snap) const
+    {
+        snap.bid_levels = depth(Side::Bid, snap.bids.data(), N);
+        snap.ask_levels = depth(Side::Ask, snap.asks.data(), N);
+    }
+
+    // Incremental L2 feed. enable_l2_feed(n) preallocates a ring of n events (0 turns the
+    // feed off); every mutation then pushes its level and top-of-book events, which a
+    // publisher drains in batches via l2_feed().drain(). The feed starts from the book as
+    // it is when enabled (take a depth() snapshot then), and a non-zero
+    // l2_feed().dropped() means the ring overflowed and the publisher must resnapshot.
+    void enable_l2_feed(size_t capacity);
+    EventRing<L2Update> &l2_feed() { return l2; }
+
+    // Best bid/offer, republished by the book's thread after every mutation that changes
+    // either side's best level. Unlike the rest of the API this may be called from any
+    // thread while the book is being mutated: it reads a seqlock and never blocks the
+    // writer. bbo_version() changes whenever a new BBO was published.
+    Bbo bbo() const { return bbo_pub.load(); }
+    uint64_t bbo_version() const { return bbo_pub.version(); }
 
     // Get order info by id
-    optional<shared_ptr<Order>> get_order(const string &id) const;
+    optional<OrderRef> get_order(const string &id) const;
+    optional<OrderRef> get_order(OrderHandle h) const;
     // Last transaction on order id (if exists)
     optional<Transaction> last_transaction(const string &id) const;
-    // Iterate orders created before/after given time (across entire book)
-    vector<shared_ptr<Order>> orders_created_before(TimePoint t) const;
-    vector<shared_ptr<Order>> orders_created_after(TimePoint t) const;
-    vector<shared_ptr<Order>> orders_updated_before(TimePoint t) const;
-    vector<shared_ptr<Order>> orders_updated_after(TimePoint t) const;
+    optional<Transaction> last_transaction(OrderHandle h) const;
+    // Iterate orders created/updated before/after given time (across entire book).
+    // Served from ordered time indexes: O(log N + k), results in ascending time order.
+    vector<OrderRef> orders_created_before(TimePoint t) const;
+    vector<OrderRef> orders_created_after(TimePoint t) const;
+    vector<OrderRef> orders_updated_before(TimePoint t) const;
+    vector<OrderRef> orders_updated_after(TimePoint t) const;
+
+    // Allocation-free traversal of the live structures, in the same order as the
+    // vector-returning queries above. The visitor may return bool: false stops the walk
+    // early (a void visitor always runs to the end). Don't mutate the book from inside.
+
+    // f(const PriceLevel &) for each level in priority order
+    template <class F>
+    void for_each_level(Side s, F &&f) const
+    {
+        OB_TIME(Query);
+        with_levels(s, [&](auto &pl_map) {
+            for (auto &kv : pl_map)
+                if (!visit(f, kv.second)) return;
+        });
+    }
+    // f(const Order &) for each order at a price level, by priority
+    template <class F>
+    void for_each_order_at(Side s, Price price, F &&f) const
+    {
+        OB_TIME(Query);
+        walk_level(s, price, [&](const OrderNode *o) { return visit(f, view(o)); });
+    }
+    // f(const Order &) for each order on a side, by price then time priority
+    template <class F>
+    void for_each_order_on_side(Side s, F &&f) const
+    {
+        OB_TIME(Query);
+        walk_side(s, [&](const OrderNode *o) { return visit(f, view(o)); });
+    }
+    // f(const Order &) for each order in the time range, in ascending time order
+    template <class F>
+    void for_each_created_before(TimePoint t, F &&f) const
+    {
+        OB_TIME(Query);
+        walk_times(by_created.begin(), by_created.lower_bound({t, 0}), as_order_visitor(f));
+    }
+    template <class F>
+    void for_each_created_after(TimePoint t, F &&f) const
+    {
+        OB_TIME(Query);
+        walk_times(by_created.upper_bound({t, kInvalidHandle}), by_created.end(), as_order_visitor(f));
+    }
+    template <class F>
+    void for_each_updated_before(TimePoint t, F &&f) const
+    {
+        OB_TIME(Query);
+        walk_times(by_updated.begin(), by_updated.lower_bound({t, 0}), as_order_visitor(f));
+    }
+    template <class F>
+    void for_each_updated_after(TimePoint t, F &&f) const
+    {
+        OB_TIME(Query);
+        walk_times(by_updated.upper_bound({t, kInvalidHandle}), by_updated.end(), as_order_visitor(f));
+    }
+
+    // Per-operation latency (p50/p99/p99.9/max). Recorded only when built with
+    // -DOB_INSTRUMENT: every public call is timed with cycle_now() into a log-bucketed
+    // histogram. Without the flag nothing is recorded and dump_latency says so.
+    void dump_latency(ostream &os) const;
+#ifdef OB_INSTRUMENT
+    const OpLatency<BookOp> &latency() const { return lat; }
+    void reset_latency() { lat.reset(); }
+#endif
 
    private:
-    // Underlying containers
-    // For bids: map with custom comparator for descending prices
-    map<double, PriceLevel, DescPrice> bid_book;
-    map<double, PriceLevel> ask_book; // ascending by default
-
-    // Lookup info: for fast O(1) find by id and removal/reinsertion
-    struct OrderLookup {
-        Side side;
-        double price;
-        list<shared_ptr<Order>>::iterator list_it;
-    };
-    unordered_map<string, OrderLookup> orders_by_id;
+    static Price valid_tick(Price t) { return t.units > 0 ? t : Price::from_units(1); }
+    bool on_tick(Price p) const { return p.units % tick.units == 0; }
+    // A new order on side s may rest at p: on the tick grid and within the level storage
+    bool can_rest(Side s, Price p) const
+    {
+        return on_tick(p) && with_side(s, [&](auto &sb) { return sb.fits(p); });
+    }
+
+    // A new order for h may be added at p: h interned and not on the book (so its id is
+    // readable for journalable()), p a price it could rest at, and a non-zero quantity
+    bool can_add(OrderHandle h, Side s, Price p, uint64_t qty) const
+    {
+        return qty > 0 && ids.contains(h) && !is_live(h) && can_rest(s, p) && journalable(h);
+    }
+
+    // Resolve a call's TimePoint (see set_clock) and advance last_stamp past it. Inside
+    // apply_batch the clock was read once for the packet, so a default stamp is the next
+    // tick after the last one.
+    TimePoint stamp(TimePoint t)
+    {
+        if (t == kBookTime)
+            t = batching ? last_stamp + TimePoint::duration(1)
+                         : max(clock_now(), last_stamp + TimePoint::duration(1));
+        if (t > last_stamp) last_stamp = t;
+        return t;
+    }
+    TimePoint clock_now() const
+    {
+        switch (clock_src)
+        {
+            case BookClock::System: break;
+            case BookClock::Tsc:
+                return tsc_origin + chrono::duration_cast<TimePoint::duration>(chrono::nanoseconds(
+                                        int64_t(double(cycle_now() - tsc_base) * ns_per_cycle)));
+            case BookClock::Caller: return caller_time;
+            case BookClock::Sequence: return TimePoint();
+        }
+        return now_tp();
+    }
+    BookClock clock_src = BookClock::System;
+    TimePoint last_stamp{};  // latest time recorded by the book
+    TimePoint caller_time{}; // BookClock::Caller
+    TimePoint tsc_origin{};  // BookClock::Tsc: wall time at cycle count tsc_base
+    uint64_t tsc_base = 0;
+    double ns_per_cycle = 1.0;
+
+    // Rest an order that passed can_add (add_order without journaling; used by add_and_match)
+    void insert_order(OrderHandle h, Side side, Price price, uint64_t qty, TimePoint t);
+    // add_and_match that appends to fills instead of clearing it (used by apply_batch)
+    MatchResult match_order(OrderHandle h, Side side, Price price, uint64_t qty, vector<Fill> &fills,
+                            TimePoint t);
+
+    // Side-specialised bodies of the mutations, reached through with_side
+    template <class SB>
+    void link_order(SB &sb, OrderNode *o, Price price);
+    template <class SB>
+    void unlink_order(SB &sb, OrderNode *o);
+    template <class SB>
+    uint64_t sweep(SB &opp, Price limit, uint64_t qty, vector<Fill> &fills, TimePoint t);
+    template <class SB>
+    bool amend_in(SB &sb, OrderNode *o, optional<Price> new_price, optional<uint64_t> new_qty, TimePoint t);
+
+    JournalWriter *journal = nullptr;
+    bool journalable(OrderHandle h) const { return !journal || ids.id(h).size() <= kJournalMaxId; }
+    void journal_op(JournalOp op, OrderHandle h, TimePoint t, Side side = Side::Bid, uint8_t flags = 0,
+                    Price price = Price(), uint64_t qty = 0);
+
+    Price tick;
+
+    // Levels and totals per side
+    SideBook<Side::Bid, Backend> bids;
+    SideBook<Side::Ask, Backend> asks;
+    const SideTotals &totals(Side s) const { return s == Side::Bid ? bids.totals : asks.totals; }
+
+    // Run fn on the SideBook of s: the one runtime side branch of a call
+    template <class Fn>
+    decltype(auto) with_side(Side s, Fn &&fn) const
+    {
+        if (s == Side::Bid) return fn(bids);
+        return fn(asks);
+    }
+    template <class Fn>
+    decltype(auto) with_side(Side s, Fn &&fn)
+    {
+        if (s == Side::Bid) return fn(bids);
+        return fn(asks);
+    }
+
+    bool is_live(OrderHandle h) const { return orders.find(h) != nullptr; }
+    // Drop a handle whose order left the book
+    void retire(OrderHandle h);
+    void release_id(OrderHandle h);
+
+    // Ordered (time, handle) indexes for the created/updated range queries
+    // Both draw tree nodes from one NodePool, so add/cancel reuse freed nodes instead of
+    // allocating once the pool has grown
+    using TimeKey = pair<TimePoint, OrderHandle>;
+    using TimeIndex = set<TimeKey, less<TimeKey>, NodePoolAllocator<TimeKey>>;
+    TimeIndex by_created{less<TimeKey>(), NodePoolAllocator<TimeKey>(make_shared<NodePool>())};
+    TimeIndex by_updated{less<TimeKey>(), by_created.get_allocator()};
+    // Move an order to time t in the update index (priority-changing amends)
+    void touch(OrderInfo *i, OrderHandle h, TimePoint t);
+    // Strict time bounds: lower_bound({t, 0}) is the first entry at t and
+    // upper_bound({t, kInvalidHandle}) the first entry after t
+    template <class F>
+    void walk_times(typename TimeIndex::const_iterator first,
+                    typename TimeIndex::const_iterator last, F &&f) const
+    {
+        for (; first != last; ++first)
+            if (!f(orders.get(first->second))) return;
+    }
+    // f(const OrderNode *) -> bool (false stops) over one level / a whole side, by priority.
+    // The visitors wrap these with view(); the vector queries collect ref()s.
+    template <class F>
+    void walk_level(Side s, Price price, F &&f) const
+    {
+        with_side(s, [&](auto &sb) {
+            if (const PriceLevel *pl = sb.find(price))
+                for (const OrderNode *o = pl->head; o; o = o->next)
+                    if (!f(o)) return;
+        });
+    }
+    template <class F>
+    void walk_side(Side s, F &&f) const
+    {
+        with_levels(s, [&](auto &pl_map) {
+            for (auto &kv : pl_map)
+                for (const OrderNode *o = kv.second.head; o; o = o->next)
+                    if (!f(o)) return;
+        });
+    }
+    template <class F>
+    auto as_order_visitor(F &f) const
+    {
+        return [this, &f](const OrderNode *o) { return visit(f, view(o)); };
+    }
+
+    // Query-side views of a live order: hot node plus its cold info
+    Order view(const OrderNode *o) const { return Order(*o, *info.get(o->handle)); }
+    OrderRef ref(const OrderNode *o) const { return OrderRef(o, info.get(o->handle)); }
+
+    // Call a visitor; true means keep going
+    template <class F, class... A>
+    static bool visit(F &f, A &&...a)
+    {
+        if constexpr (is_same_v<invoke_result_t<F &, A...>, bool>)
+            return f(std::forward<A>(a)...);
+        else
+        {
+            f(std::forward<A>(a)...);
+            return true;
+        }
+    }
+    // Run fn on the level container of a side
+    template <class Fn>
+    void with_levels(Side s, Fn &&fn) const
+    {
+        with_side(s, [&](auto &sb) { fn(sb.levels); });
+    }
+    // Top-of-book and L2 feed hooks. publish_level is a no-op while the feed is disabled
+    // and must run before an emptied level is dropped; publish_top runs once the
+    // mutation is complete and republishes the BBO if the touch moved.
+    void publish_level(Side s, const PriceLevel &pl, bool created)
+    {
+        if (!l2.enabled()) return;
+        L2Event type = pl.empty() ? L2Event::LevelDeleted : created ? L2Event::NewLevel : L2Event::LevelChanged;
+        l2.push({type, s, {pl.price, pl.quantity, uint32_t(pl.count)}});
+    }
+    void publish_top();
+    LevelSummary best_level(Side s) const;
+    EventRing<L2Update> l2;
+    LevelSummary last_top[2]{}; // last published best level, indexed by Side
+    Seqlock<Bbo> bbo_pub;       // last_top for other threads
+    bool batching = false;      // inside apply_batch: publish_top waits for the end, stamp skips the clock
+    vector<OrderHandle> batch_released; // ids of orders that left the book during apply_batch
+
+    IdInterner ids;
+    // Pooled order storage, indexed by OrderHandle: O(1) find by handle for
+    // removal/reinsertion, and no heap allocation per add/cancel in steady state.
+    // Hot nodes and cold info are parallel pools; a handle is live in both or neither.
+    SlabPool<OrderNode> orders;
+    SlabPool<OrderInfo> info;
+
+#ifdef OB_INSTRUMENT
+    mutable OpLatency<BookOp> lat;
+#endif
 };
 
+using OrderBook = BasicOrderBook<MapBackend>;
+using LadderOrderBook = BasicOrderBook<LadderBackend>;
+
+extern template class BasicOrderBook<MapBackend>;
+extern template class BasicOrderBook<LadderBackend>;
+
 } //namespace
@@ -0,0 +1,42 @@
+#pragma once
+#include <cmath>
+#include <cstdint>
+#include <ostream>
+
+// Number of decimal places carried by Price. Override at build time if an instrument
+// needs finer resolution (e.g. -DOB_PRICE_DECIMALS=8).
+#ifndef OB_PRICE_DECIMALS
+#define OB_PRICE_DECIMALS 4
+#endif
+
+namespace ob
+{
+
+constexpr int64_t decimal_scale(int decimals) { return decimals == 0 ? 1 : 10 * decimal_scale(decimals - 1); }
+
+// Fixed-point price: an integer count of 1/scale units.
+// Doubles are converted once at the API edge (rounded to the nearest unit), so every
+// key compare and hash inside the book is an integer operation, and 50.1 computed two
+// different ways lands on the same level.
+struct Price {
+    static constexpr int64_t scale = decimal_scale(OB_PRICE_DECIMALS);
+
+    int64_t units = 0;
+
+    constexpr Price() = default;
+    Price(double d) : units(std::llround(d * double(scale))) {}
+
+    static constexpr Price from_units(int64_t u) { Price p; p.units = u; return p; }
+    double to_double() const { return double(units) / double(scale); }
+
+    friend constexpr bool operator==(Price a, Price b) { return a.units == b.units; }
+    friend constexpr bool operator!=(Price a, Price b) { return a.units != b.units; }
+    friend constexpr bool operator<(Price a, Price b) { return a.units < b.units; }
+    friend constexpr bool operator>(Price a, Price b) { return a.units > b.units; }
+    friend constexpr bool operator<=(Price a, Price b) { return a.units <= b.units; }
+    friend constexpr bool operator>=(Price a, Price b) { return a.units >= b.units; }
+
+    friend std::ostream &operator<<(std::ostream &os, Price p) { return os << p.to_double(); }
+};
+
+} // namespace ob
@@ -0,0 +1,246 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <iterator>
+#include <limits>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "OccupancyBitmap.h"
+#include "Price.h"
+
+namespace ob
+{
+
+// Tick-indexed price ladder: price levels live in a contiguous array indexed by the
+// integer tick offset from a moving anchor, so finding a level is an index computation
+// instead of a tree walk.
+//
+// Exposes the subset of the std::map interface the order book uses (find, emplace,
+// erase, begin/end in priority order, size/empty) so it can be swapped in for
+// map<Price, PriceLevel, Cmp>. Cmp::descending picks the priority direction
+// (bids: highest tick first, asks: lowest tick first).
+//
+// Prices are expected on the tick grid (the book validates this), so the slot of a
+// price is (units / tick units) - anchor. The array grows (and re-anchors) to cover any
+// price that is added, and re-centers on the next price when the ladder becomes empty.
+// One ladder spans at most kMaxSpanTicks from its lowest to its highest level, which
+// bounds the array at 2 * kMaxSpanTicks slots; callers check fits() before adding a
+// level (the book rejects such prices), so a stray far-away price can't exhaust memory.
+//
+// Slots only hold pointers: the levels themselves live in a separate address-stable
+// store (recycled through a free list), so like std::map a Level* stays valid until its
+// level is erased, however the array is re-anchored.
+//
+// An OccupancyBitmap over the slots finds the next level in either direction with a
+// few bit scans (plus one word per 2^18 empty slots), so dropping the best level of a
+// sparse book doesn't walk empty ticks.
+template <class Level, class Cmp>
+class PriceLadder
+{
+   public:
+    using key_type = Price;
+    using mapped_type = Level;
+    using value_type = std::pair<const Price, Level>;
+
+   private:
+    static constexpr int64_t kEnd = std::numeric_limits<int64_t>::min();
+    static constexpr size_t kInitialTicks = 1024;
+
+   public:
+    // Widest range of levels one ladder holds, in ticks (2^21: 20,971.52 at tick 0.01)
+    static constexpr int64_t kMaxSpanTicks = int64_t(1) << 21;
+
+   private:
+
+    template <bool Const>
+    class basic_iterator
+    {
+        using ladder_ptr = std::conditional_t<Const, const PriceLadder *, PriceLadder *>;
+        ladder_ptr l_ = nullptr;
+        int64_t tick_ = kEnd;
+        friend class PriceLadder;
+        basic_iterator(ladder_ptr l, int64_t tick) : l_(l), tick_(tick) {}
+
+       public:
+        using iterator_category = std::bidirectional_iterator_tag;
+        using value_type = PriceLadder::value_type;
+        using difference_type = std::ptrdiff_t;
+        using reference = std::conditional_t<Const, const value_type &, value_type &>;
+        using pointer = std::conditional_t<Const, const value_type *, value_type *>;
+
+        basic_iterator() = default;
+        // iterator -> const_iterator
+        template <bool C = Const, class = std::enable_if_t<C>>
+        basic_iterator(const basic_iterator<false> &o) : l_(o.l_), tick_(o.tick_) {}
+
+        reference operator*() const { return *l_->slot(tick_); }
+        pointer operator->() const { return &**this; }
+        basic_iterator &operator++() { tick_ = l_->next_after(tick_); return *this; }
+        basic_iterator &operator--() { tick_ = (tick_ == kEnd) ? l_->worst_ : l_->prev_before(tick_); return *this; }
+        basic_iterator operator++(int) { auto t = *this; ++*this; return t; }
+        basic_iterator operator--(int) { auto t = *this; --*this; return t; }
+        bool operator==(const basic_iterator &o) const { return tick_ == o.tick_; }
+        bool operator!=(const basic_iterator &o) const { return tick_ != o.tick_; }
+    };
+
+   public:
+    using iterator = basic_iterator<false>;
+    using const_iterator = basic_iterator<true>;
+
+    explicit PriceLadder(Price tick_size) : tick_units_(std::max<int64_t>(tick_size.units, 1)) {}
+    // copies would point into the source's level store
+    PriceLadder(const PriceLadder &) = delete;
+    PriceLadder &operator=(const PriceLadder &) = delete;
+    PriceLadder(PriceLadder &&) = default;
+    PriceLadder &operator=(PriceLadder &&) = default;
+
+    size_t size() const { return count_; }
+    bool empty() const { return count_ == 0; }
+
+    iterator begin() { return {this, empty() ? kEnd : best_}; }
+    iterator end() { return {this, kEnd}; }
+    const_iterator begin() const { return {this, empty() ? kEnd : best_}; }
+    const_iterator end() const { return {this, kEnd}; }
+
+    iterator find(Price price) { return {this, occupied(to_tick(price)) ? to_tick(price) : kEnd}; }
+    const_iterator find(Price price) const { return {this, occupied(to_tick(price)) ? to_tick(price) : kEnd}; }
+
+    std::pair<iterator, bool> emplace(Price price, Level level)
+    {
+        int64_t t = to_tick(price);
+        if (occupied(t)) return {iterator(this, t), false};
+
+        cover(t);
+        Node *n;
+        if (!free_.empty())
+        {
+            n = free_.back();
+            free_.pop_back();
+        }
+        else
+            n = &store_.emplace_back();
+        n->emplace(price, std::move(level));
+        slots_[t - anchor_] = n;
+        occ_.set(size_t(t - anchor_));
+        if (count_++ == 0)
+            best_ = worst_ = t;
+        else
+        {
+            if (better(t, best_)) best_ = t;
+            if (better(worst_, t)) worst_ = t;
+        }
+        return {iterator(this, t), true};
+    }
+
+    // The hint is not needed to place a level; accepted for std::map compatibility
+    iterator emplace_hint(const_iterator, Price price, Level level) { return emplace(price, std::move(level)).first; }
+
+    // Erase a level; returns the next level in priority order
+    iterator erase(iterator it)
+    {
+        int64_t t = it.tick_;
+        int64_t next = next_after(t);
+        Node *&n = slots_[t - anchor_];
+        n->reset();
+        free_.push_back(n);
+        n = nullptr;
+        occ_.reset(size_t(t - anchor_));
+        if (--count_ == 0) return end();
+        if (t == best_) best_ = next;
+        if (t == worst_) worst_ = prev_before(t);
+        return {this, next};
+    }
+    size_t erase(Price price)
+    {
+        auto it = find(price);
+        if (it == end()) return 0;
+        erase(it);
+        return 1;
+    }
+
+    // A level at price keeps the ladder within kMaxSpanTicks (always true when empty)
+    bool fits(Price price) const
+    {
+        if (empty()) return true;
+        int64_t t = to_tick(price);
+        return std::max({t, best_, worst_}) - std::min({t, best_, worst_}) < kMaxSpanTicks;
+    }
+
+   private:
+    int64_t to_tick(Price price) const { return price.units / tick_units_; }
+
+    bool in_range(int64_t t) const { return t >= anchor_ && t < anchor_ + int64_t(slots_.size()); }
+    bool occupied(int64_t t) const { return in_range(t) && slots_[t - anchor_] != nullptr; }
+    static bool better(int64_t a, int64_t b) { return Cmp::descending ? a > b : a < b; }
+
+    value_type *slot(int64_t t) { return &**slots_[t - anchor_]; }
+    const value_type *slot(int64_t t) const { return &**slots_[t - anchor_]; }
+
+    // Next occupied tick after t in priority order (kEnd if t is the worst level)
+    int64_t next_after(int64_t t) const
+    {
+        if (t == worst_) return kEnd;
+        return anchor_ + int64_t(Cmp::descending ? occ_.find_prev(size_t(t - anchor_ - 1))
+                                                 : occ_.find_next(size_t(t - anchor_ + 1)));
+    }
+    // Previous occupied tick before t in priority order (kEnd if t is the best level)
+    int64_t prev_before(int64_t t) const
+    {
+        if (t == best_) return kEnd;
+        return anchor_ + int64_t(Cmp::descending ? occ_.find_next(size_t(t - anchor_ + 1))
+                                                 : occ_.find_prev(size_t(t - anchor_ - 1)));
+    }
+
+    // Make sure tick t has a slot, re-anchoring the array around it if needed
+    void cover(int64_t t)
+    {
+        if (in_range(t)) return;
+
+        size_t cap = std::max(slots_.size(), kInitialTicks);
+        if (count_ == 0)
+        {
+            // nothing to keep: re-center on the new price
+            slots_.assign(cap, nullptr);
+            occ_.assign(cap);
+            anchor_ = t - int64_t(cap / 2);
+            return;
+        }
+
+        // only the occupied span has to stay addressable (fits() bounds it)
+        int64_t lo = std::min({t, best_, worst_});
+        int64_t hi = std::max({t, best_, worst_});
+        while (cap < size_t(hi - lo + 1) * 2) cap *= 2;
+
+        // keep the occupied span roughly centered so further drift is cheap
+        int64_t new_anchor = lo - int64_t(cap - size_t(hi - lo + 1)) / 2;
+        std::vector<Node *> grown(cap, nullptr);
+        occ_.assign(cap);
+        for (size_t i = 0; i < slots_.size(); ++i)
+            if (slots_[i])
+            {
+                size_t j = size_t(anchor_ + int64_t(i) - new_anchor);
+                grown[j] = slots_[i];
+                occ_.set(j);
+            }
+        slots_ = std::move(grown);
+        anchor_ = new_anchor;
+    }
+
+    using Node = std::optional<value_type>;
+
+    int64_t tick_units_;
+    std::vector<Node *> slots_;     // nullptr = no level at that tick
+    std::deque<Node> store_;        // deque: nodes never move
+    std::vector<Node *> free_;
+    OccupancyBitmap occ_;           // bit i set <=> slots_[i] != nullptr
+    int64_t anchor_ = 0; // tick of slots_[0]
+    size_t count_ = 0;
+    int64_t best_ = kEnd;
+    int64_t worst_ = kEnd;
+};
+
+} // namespace ob
@@ -0,0 +1,68 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace ob
+{
+
+// Single-writer sequence lock around a small trivially copyable value, on its own
+// cache line(s). store() never waits for readers. load() from any thread retries
+// until it copies the value without a store overlapping, so readers always see a
+// value that was actually stored, never a mix of two. The payload is kept in relaxed
+// atomic words so concurrent copies are well defined.
+template <class T>
+class alignas(64) Seqlock
+{
+    static_assert(std::is_trivially_copyable<T>::value, "seqlock payload is copied bytewise");
+    static constexpr size_t kWords = (sizeof(T) + 7) / 8;
+
+   public:
+    Seqlock() { store(T{}); }
+    Seqlock(const Seqlock &o) { store(o.load()); }
+    Seqlock &operator=(const Seqlock &o)
+    {
+        store(o.load());
+        return *this;
+    }
+
+    // Writer thread only
+    void store(const T &v)
+    {
+        uint64_t buf[kWords] = {};
+        std::memcpy(buf, &v, sizeof(T));
+        uint64_t s = seq.load(std::memory_order_relaxed);
+        seq.store(s + 1, std::memory_order_relaxed); // odd: write in progress
+        std::atomic_thread_fence(std::memory_order_release);
+        for (size_t i = 0; i < kWords; ++i) words[i].store(buf[i], std::memory_order_relaxed);
+        seq.store(s + 2, std::memory_order_release);
+    }
+
+    // Any thread
+    T load() const
+    {
+        uint64_t buf[kWords];
+        uint64_t s0, s1;
+        do
+        {
+            s0 = seq.load(std::memory_order_acquire);
+            if (s0 & 1) continue; // writer mid-store
+            for (size_t i = 0; i < kWords; ++i) buf[i] = words[i].load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            s1 = seq.load(std::memory_order_relaxed);
+        } while ((s0 & 1) || s0 != s1);
+        T v;
+        std::memcpy(&v, buf, sizeof(T));
+        return v;
+    }
+
+    // Number of stores so far; changes whenever the value may have changed
+    uint64_t version() const { return seq.load(std::memory_order_acquire) / 2; }
+
+   private:
+    std::atomic<uint64_t> seq{0};
+    std::atomic<uint64_t> words[kWords];
+};
+
+} // namespace ob
@@ -0,0 +1,80 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace ob
+{
+
+// Slab storage for objects addressed by a dense integer index (an OrderHandle).
+// Slots live in fixed-size chunks that are never moved or freed while the pool exists,
+// so a T* stays valid until its slot is destroyed. Chunks are only allocated the first
+// time an index in their range is used; after that, construct/destroy never touch the
+// heap.
+template <class T, size_t ChunkBits = 12>
+class SlabPool
+{
+    static constexpr size_t kChunkSize = size_t(1) << ChunkBits;
+    static constexpr size_t kChunkMask = kChunkSize - 1;
+    using Storage = std::aligned_storage_t<sizeof(T), alignof(T)>;
+
+   public:
+    SlabPool() = default;
+    SlabPool(const SlabPool &) = delete;
+    SlabPool &operator=(const SlabPool &) = delete;
+    SlabPool(SlabPool &&) = default;
+    SlabPool &operator=(SlabPool &&) = default;
+    ~SlabPool()
+    {
+        for (size_t i = 0; i < live.size(); ++i)
+            if (live[i]) destroy(uint32_t(i));
+    }
+
+    template <class... Args>
+    T *construct(uint32_t idx, Args &&...args)
+    {
+        while (idx >= capacity())
+        {
+            chunks.emplace_back(new Storage[kChunkSize]);
+            live.resize(capacity(), false);
+        }
+        T *p = new (slot(idx)) T(std::forward<Args>(args)...);
+        live[idx] = true;
+        return p;
+    }
+
+    void destroy(uint32_t idx)
+    {
+        std::launder(reinterpret_cast<T *>(slot(idx)))->~T();
+        live[idx] = false;
+    }
+
+    // Object at idx, or nullptr if the slot is empty
+    T *find(uint32_t idx) { return idx < live.size() && live[idx] ? get(idx) : nullptr; }
+    const T *find(uint32_t idx) const { return idx < live.size() && live[idx] ? get(idx) : nullptr; }
+
+    // Object at idx; the slot must be live
+    T *get(uint32_t idx) { return std::launder(reinterpret_cast<T *>(slot(idx))); }
+    const T *get(uint32_t idx) const { return std::launder(reinterpret_cast<const T *>(slot(idx))); }
+
+    // Hint the cache to fetch slot idx ahead of use; any idx is allowed
+    void prefetch(uint32_t idx) const
+    {
+        if (idx < capacity()) __builtin_prefetch(slot(idx));
+    }
+
+    // Number of slots backed by allocated chunks
+    size_t capacity() const { return chunks.size() * kChunkSize; }
+
+   private:
+    Storage *slot(uint32_t idx) const { return &chunks[idx >> ChunkBits][idx & kChunkMask]; }
+
+    std::vector<std::unique_ptr<Storage[]>> chunks;
+    std::vector<bool> live;
+};
+
+} // namespace ob
@@ -0,0 +1,34 @@
+#pragma once
+#include <cstdint>
+
+namespace ob
+{
+
+// Point-in-time book snapshot file (BasicOrderBook::save_snapshot / load_snapshot):
+// a SnapshotHeader, then bid_orders + ask_orders entries, bids first. Orders are in
+// priority order (levels best first, FIFO within a level), which is what lets the
+// loader append levels at the end of each side and orders at the back of each level.
+// Each entry is a SnapshotOrder followed by id_len bytes of id. Host byte order.
+struct SnapshotHeader {
+    char magic[8];           // "OBSNAP1\0"
+    uint32_t price_decimals; // OB_PRICE_DECIMALS of the writer
+    uint32_t reserved;
+    int64_t tick_units;      // tick size of the book, in Price units
+    uint64_t bid_orders;
+    uint64_t ask_orders;
+};
+static_assert(sizeof(SnapshotHeader) == 40, "fixed snapshot header");
+
+struct SnapshotOrder {
+    int64_t price_units;
+    uint64_t quantity;
+    int64_t created_ns;      // times as ns since the system_clock epoch
+    int64_t updated_ns;
+    int64_t txn_ns;
+    uint8_t txn_type;        // TxnType of last_txn
+    uint8_t reserved[3];
+    uint32_t id_len;
+};
+static_assert(sizeof(SnapshotOrder) == 48, "fixed snapshot order entry");
+
+} // namespace ob
@@ -0,0 +1,92 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace ob
+{
+
+// Bounded lock-free queue between exactly one producer thread and one consumer thread.
+// Capacity is a power of two, allocated once. The two indices live on separate cache
+// lines, and each side keeps a cached copy of the other side's index, so the shared
+// lines are only read when the cached view says the ring looks full (producer) or
+// empty (consumer). Nothing allocates after construction and nothing takes a lock.
+template <class T>
+class SpscRing
+{
+   public:
+    // Room for at least `capacity` elements (rounded up to a power of two)
+    explicit SpscRing(size_t capacity)
+    {
+        size_t cap = 1;
+        while (cap < capacity) cap <<= 1;
+        buf.reset(new T[cap]);
+        mask = cap - 1;
+    }
+    SpscRing(const SpscRing &) = delete;
+    SpscRing &operator=(const SpscRing &) = delete;
+
+    size_t capacity() const { return mask + 1; }
+    // Approximate when called from neither side
+    size_t size() const
+    {
+        return size_t(prod.tail.load(std::memory_order_acquire) - cons.head.load(std::memory_order_acquire));
+    }
+    bool empty() const { return size() == 0; }
+
+    // ---- producer side ----
+
+    bool try_push(const T &v) { return try_push(&v, 1) == 1; }
+
+    // Copy up to n elements in and publish them with one store. Returns how many fit.
+    size_t try_push(const T *v, size_t n)
+    {
+        uint64_t t = prod.tail.load(std::memory_order_relaxed);
+        size_t room = capacity() - size_t(t - prod.head_cache);
+        if (room < n)
+        {
+            prod.head_cache = cons.head.load(std::memory_order_acquire);
+            room = capacity() - size_t(t - prod.head_cache);
+        }
+        n = std::min(n, room);
+        for (size_t i = 0; i < n; ++i) buf[(t + i) & mask] = v[i];
+        prod.tail.store(t + n, std::memory_order_release);
+        return n;
+    }
+
+    // ---- consumer side ----
+
+    // Hand up to max_items queued elements to f(const T *items, size_t n) as at most two
+    // contiguous runs, oldest first, then release them to the producer with one store.
+    // Returns the number consumed.
+    template <class F>
+    size_t drain(F &&f, size_t max_items = SIZE_MAX)
+    {
+        uint64_t h = cons.head.load(std::memory_order_relaxed);
+        if (cons.tail_cache == h) cons.tail_cache = prod.tail.load(std::memory_order_acquire);
+        size_t n = std::min(size_t(cons.tail_cache - h), max_items);
+        if (!n) return 0;
+        size_t first = std::min(n, capacity() - size_t(h & mask));
+        f(&buf[h & mask], first);
+        if (n > first) f(&buf[0], n - first);
+        cons.head.store(h + n, std::memory_order_release);
+        return n;
+    }
+
+   private:
+    std::unique_ptr<T[]> buf;
+    uint64_t mask = 0;
+
+    struct alignas(64) Producer {
+        std::atomic<uint64_t> tail{0}; // next slot to fill
+        uint64_t head_cache = 0;       // last head seen by the producer
+    } prod;
+    struct alignas(64) Consumer {
+        std::atomic<uint64_t> head{0}; // next slot to drain
+        uint64_t tail_cache = 0;       // last tail seen by the consumer
+    } cons;
+};
+
+} // namespace ob
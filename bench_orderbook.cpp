@@ -0,0 +1,791 @@
+#include <benchmark/benchmark.h>
+#include <deque>
+#include <mutex>
+#include <random>
+#include <thread>
+#include "BookManager.h"
+#include "OrderBook.h"
+
+// --------------------------- OrderBook Benchmarks ----------------------------
+// Every benchmark runs against both level backends (OrderBook = std::map levels,
+// LadderOrderBook = tick-indexed array). Args are {price levels per side, orders per level}.
+
+using namespace ob;
+
+namespace
+{
+constexpr int64_t kTick = 100;                 // 0.01 in Price units
+constexpr int64_t kMid = 10000 * Price::scale; // bids below, asks above
+constexpr size_t kBatch = 1024;                // ops between untimed book restores
+
+Price level_price(Side s, int level)
+{
+    return Price::from_units(s == Side::Bid ? kMid - (level + 1) * kTick : kMid + (level + 1) * kTick);
+}
+
+// A book with `levels` levels per side and `queue` orders per level, plus the ids and
+// sides of every resting order (slot i keeps the same id when it is cancelled/re-added)
+template <class Book>
+struct BenchBook {
+    Book book{Price::from_units(kTick)};
+    int levels;
+    int queue;
+    vector<string> ids;
+    vector<Side> sides;
+    mt19937_64 rng{12345};
+
+    BenchBook(int levels_, int queue_) : levels(levels_), queue(queue_)
+    {
+        ids.reserve(size_t(levels) * queue * 2);
+        for (int q = 0; q < queue; ++q)
+            for (int l = 0; l < levels; ++l)
+                for (Side s : {Side::Bid, Side::Ask})
+                {
+                    ids.push_back("o" + to_string(ids.size()));
+                    sides.push_back(s);
+                    book.add_order(ids.back(), s, level_price(s, l), 1000000);
+                }
+    }
+
+    size_t random_slot() { return rng() % ids.size(); }
+    // Cancel/replace flows must keep every order resting, or later iterations only time
+    // rejections
+    bool intact() const
+    {
+        return book.num_orders_on_side(Side::Bid) + book.num_orders_on_side(Side::Ask) == ids.size();
+    }
+    int random_level() { return int(rng() % uint64_t(levels)); }
+};
+
+// Book sizes: 10 .. 100k levels, 1 .. 64 orders per level, capped at ~1M orders per side
+void BookArgs(benchmark::internal::Benchmark *b)
+{
+    for (int levels : {10, 1000, 100000})
+        for (int queue : {1, 8, 64})
+            if (int64_t(levels) * queue <= 1000000) b->Args({levels, queue});
+}
+} // namespace
+
+// ---------------------------------------------------------------------------
+// Single operations
+// ---------------------------------------------------------------------------
+template <class Book>
+static void BM_AddOrder(benchmark::State &state)
+{
+    BenchBook<Book> bb(int(state.range(0)), int(state.range(1)));
+    vector<string> fresh;
+    for (size_t i = 0; i < kBatch; ++i) fresh.push_back("n" + to_string(i));
+    size_t i = 0;
+    for (auto _ : state)
+    {
+        Side s = (i & 1) ? Side::Ask : Side::Bid;
+        benchmark::DoNotOptimize(bb.book.add_order(fresh[i], s, level_price(s, bb.random_level()), 100));
+        if (++i == kBatch)
+        {
+            state.PauseTiming();
+            for (auto &id : fresh) bb.book.remove_order(id);
+            i = 0;
+            state.ResumeTiming();
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+template <class Book>
+static void BM_RemoveOrder(benchmark::State &state)
+{
+    BenchBook<Book> bb(int(state.range(0)), int(state.range(1)));
+    vector<string> fresh;
+    vector<Price> prices;
+    auto refill = [&] {
+        for (size_t k = 0; k < kBatch; ++k)
+        {
+            Side s = (k & 1) ? Side::Ask : Side::Bid;
+            bb.book.add_order(fresh[k], s, prices[k], 100);
+        }
+    };
+    for (size_t k = 0; k < kBatch; ++k)
+    {
+        fresh.push_back("n" + to_string(k));
+        prices.push_back(level_price((k & 1) ? Side::Ask : Side::Bid, bb.random_level()));
+    }
+    refill();
+    size_t i = 0;
+    for (auto _ : state)
+    {
+        // cancel in random-ish order relative to arrival
+        benchmark::DoNotOptimize(bb.book.remove_order(fresh[(i * 7919) % kBatch]));
+        if (++i == kBatch)
+        {
+            state.PauseTiming();
+            refill();
+            i = 0;
+            state.ResumeTiming();
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+// Aggressive orders that each take out the whole best ask level: a walk of the
+// level's queue that fills and retires every maker. The book is rebuilt, untimed,
+// once the side is exhausted. Items are maker orders filled.
+template <class Book>
+static void BM_SweepLevel(benchmark::State &state)
+{
+    const int levels = int(state.range(0)), queue = int(state.range(1));
+    auto bb = make_unique<BenchBook<Book>>(levels, queue);
+    vector<Fill> fills;
+    int swept = 0;
+    for (auto _ : state)
+    {
+        bb->book.add_and_match("sweep", Side::Bid, level_price(Side::Ask, swept), uint64_t(queue) * 1000000, fills);
+        if (++swept == levels)
+        {
+            state.PauseTiming();
+            bb = make_unique<BenchBook<Book>>(levels, queue);
+            swept = 0;
+            state.ResumeTiming();
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * queue);
+}
+
+// Price change: move a random order to a random level on its side (priority reset)
+template <class Book>
+static void BM_AmendPrice(benchmark::State &state)
+{
+    BenchBook<Book> bb(int(state.range(0)), int(state.range(1)));
+    for (auto _ : state)
+    {
+        size_t k = bb.random_slot();
+        benchmark::DoNotOptimize(
+            bb.book.amend_order(bb.ids[k], level_price(bb.sides[k], bb.random_level()), nullopt));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+// Same price, quantity up: order moves to the back of its level
+template <class Book>
+static void BM_AmendQtyUp(benchmark::State &state)
+{
+    BenchBook<Book> bb(int(state.range(0)), int(state.range(1)));
+    for (auto _ : state)
+    {
+        size_t k = bb.random_slot();
+        auto o = bb.book.get_order(bb.ids[k]);
+        benchmark::DoNotOptimize(bb.book.amend_order(bb.ids[k], nullopt, (*o)->quantity + 1));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+// Same price, quantity down: priority kept, updated in place
+template <class Book>
+static void BM_AmendQtyDown(benchmark::State &state)
+{
+    BenchBook<Book> bb(int(state.range(0)), int(state.range(1)));
+    for (auto _ : state)
+    {
+        size_t k = bb.random_slot();
+        auto o = bb.book.get_order(bb.ids[k]);
+        benchmark::DoNotOptimize(bb.book.amend_order(bb.ids[k], nullopt, max<uint64_t>((*o)->quantity - 1, 1)));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+template <class Book>
+static void BM_TopPrice(benchmark::State &state)
+{
+    BenchBook<Book> bb(int(state.range(0)), int(state.range(1)));
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(bb.book.top_price(Side::Bid));
+        benchmark::DoNotOptimize(bb.book.top_price(Side::Ask));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+template <class Book>
+static void BM_OrdersAt(benchmark::State &state)
+{
+    BenchBook<Book> bb(int(state.range(0)), int(state.range(1)));
+    for (auto _ : state)
+        benchmark::DoNotOptimize(bb.book.orders_at(Side::Bid, level_price(Side::Bid, bb.random_level())));
+    state.SetItemsProcessed(state.iterations() * state.range(1));
+}
+
+template <class Book>
+static void BM_OrdersOnSide(benchmark::State &state)
+{
+    BenchBook<Book> bb(int(state.range(0)), int(state.range(1)));
+    for (auto _ : state)
+        benchmark::DoNotOptimize(bb.book.orders_on_side(Side::Bid));
+    state.SetItemsProcessed(state.iterations() * state.range(0) * state.range(1));
+}
+
+// Same walk as BM_OrdersOnSide through the visitor: no result vector
+template <class Book>
+static void BM_ForEachOrderOnSide(benchmark::State &state)
+{
+    BenchBook<Book> bb(int(state.range(0)), int(state.range(1)));
+    for (auto _ : state)
+    {
+        uint64_t qty = 0;
+        bb.book.for_each_order_on_side(Side::Bid, [&](const Order &o) { qty += o.quantity; });
+        benchmark::DoNotOptimize(qty);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0) * state.range(1));
+}
+
+// Top-10 L2 snapshot of both sides after every message
+template <class Book>
+static void BM_DepthSnapshot(benchmark::State &state)
+{
+    BenchBook<Book> bb(int(state.range(0)), int(state.range(1)));
+    DepthSnapshot<10> snap;
+    for (auto _ : state)
+    {
+        bb.book.depth(snap);
+        benchmark::DoNotOptimize(snap);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+// Stale-order sweep: half the book was created before the cut-off
+template <class Book>
+static void BM_OrdersCreatedBeforeAfter(benchmark::State &state)
+{
+    BenchBook<Book> bb(int(state.range(0)), int(state.range(1)));
+    auto orders = bb.book.orders_on_side(Side::Bid);
+    TimePoint cut = orders[orders.size() / 2]->creation_time;
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(bb.book.orders_created_before(cut));
+        benchmark::DoNotOptimize(bb.book.orders_created_after(cut));
+    }
+    state.SetItemsProcessed(state.iterations() * 2);
+}
+
+// ---------------------------------------------------------------------------
+// Mixed workloads (one message per iteration; cancels are paired with a
+// replacement add so the book keeps its shape)
+// ---------------------------------------------------------------------------
+template <class Book>
+static void cancel_replace(BenchBook<Book> &bb)
+{
+    size_t k = bb.random_slot();
+    bb.book.remove_order(bb.ids[k]);
+    bb.book.add_order(bb.ids[k], bb.sides[k], level_price(bb.sides[k], bb.random_level()), 100);
+}
+
+template <class Book>
+static void random_amend(BenchBook<Book> &bb)
+{
+    size_t k = bb.random_slot();
+    auto o = bb.book.get_order(bb.ids[k]);
+    switch (bb.rng() % 3)
+    {
+        case 0: bb.book.amend_order(bb.ids[k], level_price(bb.sides[k], bb.random_level()), nullopt); break;
+        case 1: bb.book.amend_order(bb.ids[k], nullopt, (*o)->quantity + 1); break;
+        default: bb.book.amend_order(bb.ids[k], nullopt, max<uint64_t>((*o)->quantity - 1, 1)); break;
+    }
+}
+
+// 90% cancel/replace, 10% amend
+template <class Book>
+static void BM_CancelHeavy(benchmark::State &state)
+{
+    BenchBook<Book> bb(int(state.range(0)), int(state.range(1)));
+    for (auto _ : state)
+    {
+        if (bb.rng() % 10 < 9) cancel_replace(bb);
+        else random_amend(bb);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+// BM_CancelHeavy with the L2 feed on, drained every kBatch messages
+template <class Book>
+static void BM_CancelHeavyL2Feed(benchmark::State &state)
+{
+    BenchBook<Book> bb(int(state.range(0)), int(state.range(1)));
+    bb.book.enable_l2_feed(8 * kBatch);
+    size_t i = 0, events = 0;
+    for (auto _ : state)
+    {
+        if (bb.rng() % 10 < 9) cancel_replace(bb);
+        else random_amend(bb);
+        if (++i == kBatch)
+        {
+            events += bb.book.l2_feed().drain([](const L2Update *ev, size_t n) { benchmark::DoNotOptimize(ev + n); });
+            i = 0;
+        }
+    }
+    state.counters["events_per_msg"] = double(events) / double(state.iterations());
+    state.SetItemsProcessed(state.iterations());
+}
+
+// 70% amend (price / qty up / qty down), 30% cancel/replace
+template <class Book>
+static void BM_AmendHeavy(benchmark::State &state)
+{
+    BenchBook<Book> bb(int(state.range(0)), int(state.range(1)));
+    for (auto _ : state)
+    {
+        if (bb.rng() % 10 < 7) random_amend(bb);
+        else cancel_replace(bb);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+// Every message picks its side at random (cancel/replace, amends, and a marketable
+// order refilled at the same level), so any per-side branch in the book is
+// unpredictable
+template <class Book>
+static void BM_RandomSideFlow(benchmark::State &state)
+{
+    BenchBook<Book> bb(int(state.range(0)), int(state.range(1)));
+    vector<Fill> fills;
+    for (auto _ : state)
+    {
+        switch (bb.rng() % 4)
+        {
+            case 0: cancel_replace(bb); break;
+            case 1: random_amend(bb); break;
+            case 2:
+            {
+                size_t k = bb.random_slot();
+                bb.book.amend_order(bb.ids[k], nullopt, 1000000); // back to full size
+                break;
+            }
+            default:
+            {
+                // take one lot from the best opposite level
+                Side s = bb.rng() % 2 ? Side::Bid : Side::Ask;
+                Side opp = s == Side::Bid ? Side::Ask : Side::Bid;
+                bb.book.add_and_match("ioc", s, *bb.book.top_price(opp), 1, fills);
+                break;
+            }
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+// Improve the touch with a new level, read the BBO, then cancel it again:
+// creates and deletes the best level on every message
+template <class Book>
+static void BM_TopOfBookChurn(benchmark::State &state)
+{
+    BenchBook<Book> bb(int(state.range(0)), int(state.range(1)));
+    const string id = "touch";
+    size_t i = 0;
+    for (auto _ : state)
+    {
+        Side s = (i++ & 1) ? Side::Ask : Side::Bid;
+        bb.book.add_order(id, s, level_price(s, -1), 100); // one tick inside the best level
+        benchmark::DoNotOptimize(bb.book.top_price(s));
+        bb.book.remove_order(id);
+        benchmark::DoNotOptimize(bb.book.top_price(s));
+    }
+    state.SetItemsProcessed(state.iterations() * 2);
+}
+
+// Feed packets of range(2) messages (cancel/replace pairs and quantity amends, by
+// handle): BM_PacketSingleCalls applies each with its own call and clock read,
+// BM_PacketBatch hands the packet to apply_batch. A single-call cancel releases the id,
+// so the replace goes by id and interns it again (the free list hands back the same
+// handle); inside a batch the handle stays interned until the end of the packet.
+template <class Book>
+static vector<vector<BookMutation>> make_packets(BenchBook<Book> &bb, size_t size)
+{
+    vector<vector<BookMutation>> packets(256);
+    for (auto &p : packets)
+        while (p.size() < size)
+        {
+            size_t k = bb.random_slot();
+            OrderHandle h = bb.book.find_handle(bb.ids[k]);
+            Side s = bb.sides[k];
+            if (bb.rng() % 2)
+            {
+                p.push_back({h, JournalOp::Remove, s, 0, Price(), 0});
+                p.push_back({h, JournalOp::Add, s, 0, level_price(s, bb.random_level()), 100});
+            }
+            else
+                p.push_back({h, JournalOp::Amend, s, kJournalHasQty, Price(), 50 + bb.rng() % 100});
+        }
+    return packets;
+}
+
+template <class Book>
+static void BM_PacketSingleCalls(benchmark::State &state)
+{
+    BenchBook<Book> bb(int(state.range(0)), int(state.range(1)));
+    auto packets = make_packets(bb, size_t(state.range(2)));
+    size_t i = 0, msgs = 0;
+    for (auto _ : state)
+    {
+        for (const BookMutation &m : packets[i++ % packets.size()])
+        {
+            if (m.op == JournalOp::Remove) bb.book.remove_order(m.handle);
+            else if (m.op == JournalOp::Add)
+                bb.book.add_order(string(bb.book.order_id(m.handle)), m.side, m.price, m.quantity);
+            else bb.book.amend_order(m.handle, nullopt, m.quantity);
+            ++msgs;
+        }
+    }
+    if (!bb.intact()) state.SkipWithError("orders were lost: replaces were rejected");
+    state.SetItemsProcessed(int64_t(msgs));
+}
+
+template <class Book>
+static void BM_PacketBatch(benchmark::State &state)
+{
+    BenchBook<Book> bb(int(state.range(0)), int(state.range(1)));
+    auto packets = make_packets(bb, size_t(state.range(2)));
+    vector<Fill> fills;
+    size_t i = 0, msgs = 0;
+    for (auto _ : state)
+    {
+        auto &p = packets[i++ % packets.size()];
+        bb.book.apply_batch(p.data(), p.size(), fills);
+        msgs += p.size();
+    }
+    if (!bb.intact()) state.SkipWithError("orders were lost: replaces were rejected");
+    state.SetItemsProcessed(int64_t(msgs));
+}
+
+void PacketArgs(benchmark::internal::Benchmark *b)
+{
+    for (int levels : {1000, 100000})
+        for (int packet : {10, 50}) b->Args({levels, levels == 1000 ? 8 : 1, packet});
+}
+
+// Handle-addressed cancel/replace and quantity amends with book-stamped times, per
+// BookClock (range(0): System, Tsc, Caller, Sequence), so the clock read is a visible
+// share of each message. The cancel releases the handle, so the replace re-interns the
+// id first (and gets the same handle back).
+static void BM_BookClock(benchmark::State &state)
+{
+    BenchBook<LadderOrderBook> bb(1000, 8);
+    bb.book.set_clock(BookClock(state.range(0)));
+    bb.book.set_time(now_tp());
+    vector<OrderHandle> handles;
+    for (auto &id : bb.ids) handles.push_back(bb.book.find_handle(id));
+    for (auto _ : state)
+    {
+        size_t k = bb.random_slot();
+        Side s = bb.sides[k];
+        if (bb.rng() % 2)
+        {
+            bb.book.remove_order(handles[k]);
+            handles[k] = bb.book.intern(bb.ids[k]);
+            bb.book.add_order(handles[k], s, level_price(s, bb.random_level()), 100);
+        }
+        else
+            bb.book.amend_order(handles[k], nullopt, 50 + bb.rng() % 100);
+    }
+    if (!bb.intact()) state.SkipWithError("orders were lost: replaces were rejected");
+    state.SetItemsProcessed(state.iterations());
+}
+
+// Lock-free BBO reads from another thread while the book's thread runs the
+// TopOfBookChurn flow; range(0) = 1 runs the writer, 0 reads a quiet book
+static void BM_BboRead(benchmark::State &state)
+{
+    BenchBook<LadderOrderBook> bb(1000, 8);
+    atomic<bool> done{false};
+    thread writer;
+    if (state.range(0))
+        writer = thread([&] {
+            for (size_t i = 0; !done.load(memory_order_relaxed); ++i)
+            {
+                Side s = (i & 1) ? Side::Ask : Side::Bid;
+                bb.book.add_order("touch", s, level_price(s, -1), 100);
+                bb.book.remove_order("touch");
+            }
+        });
+    for (auto _ : state) benchmark::DoNotOptimize(bb.book.bbo());
+    done = true;
+    if (writer.joinable()) writer.join();
+    state.SetItemsProcessed(state.iterations());
+}
+
+// Sparse book (levels 500 ticks apart): cancel the best level and read the new BBO,
+// so the next level has to be found across a run of empty ticks
+template <class Book>
+static void BM_SparseTopCancel(benchmark::State &state)
+{
+    const int levels = int(state.range(0));
+    Book book{Price::from_units(kTick)};
+    auto price = [](int l) { return Price::from_units(kMid - int64_t(l + 1) * 500 * kTick); };
+    for (int l = 0; l < levels; ++l) book.add_order("s" + to_string(l), Side::Bid, price(l), 100);
+    const string top = "s0";
+    for (auto _ : state)
+    {
+        book.remove_order(top);
+        benchmark::DoNotOptimize(book.top_price(Side::Bid));
+        book.add_order(top, Side::Bid, price(0), 100);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+// ---------------------------------------------------------------------------
+// Cold start: rebuild a book by bulk-loading a snapshot vs replaying every add
+// ---------------------------------------------------------------------------
+template <class Book>
+static void BM_LoadSnapshot(benchmark::State &state)
+{
+    const string path = "bench_snapshot.bin";
+    {
+        BenchBook<Book> bb(int(state.range(0)), int(state.range(1)));
+        bb.book.save_snapshot(path);
+    }
+    for (auto _ : state)
+    {
+        Book book{Price::from_units(kTick)};
+        benchmark::DoNotOptimize(book.load_snapshot(path));
+        state.PauseTiming(); // exclude the destructor
+        { Book gone = std::move(book); }
+        state.ResumeTiming();
+    }
+    remove(path.c_str());
+    state.SetItemsProcessed(state.iterations() * state.range(0) * state.range(1) * 2);
+}
+
+template <class Book>
+static void BM_RebuildByAdds(benchmark::State &state)
+{
+    BenchBook<Book> bb(int(state.range(0)), int(state.range(1)));
+    auto orders = bb.book.orders_on_side(Side::Bid);
+    for (auto &o : bb.book.orders_on_side(Side::Ask)) orders.push_back(o);
+    for (auto _ : state)
+    {
+        Book book{Price::from_units(kTick)};
+        for (auto &o : orders) book.add_order(string(o->id), o->side, o->price, o->quantity);
+        state.PauseTiming();
+        { Book gone = std::move(book); }
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations() * int64_t(orders.size()));
+}
+
+// ---------------------------------------------------------------------------
+// Multi-symbol throughput: one producer feeding a BookManager with
+// range(0) workers and 64 symbols. Each batch is an add/remove pair per symbol
+// per round, so books stay small and the cost is routing + apply.
+// ---------------------------------------------------------------------------
+template <class Book>
+static void BM_ManagerThroughput(benchmark::State &state)
+{
+    constexpr int kSymbols = 64, kRounds = 16;
+    BookManager<Book> mgr(size_t(state.range(0)));
+    for (int s = 0; s < kSymbols; ++s) mgr.add_symbol(Price::from_units(kTick));
+    mgr.start();
+
+    // symbol-major: a symbol's 32 commands are one run for its worker, which submit()
+    // pushes into that worker's SpscRing and publishes as a single block
+    vector<BookCommand> cmds;
+    for (int s = 0; s < kSymbols; ++s)
+        for (int r = 0; r < kRounds; ++r)
+        {
+            string id = "o" + to_string(r);
+            Price px = level_price(r % 2 ? Side::Ask : Side::Bid, r);
+            cmds.push_back({SymbolId(s), make_journal_record(JournalOp::Add, id, 0, uint8_t(r % 2 ? Side::Ask : Side::Bid),
+                                                             0, px.units, 100)});
+            cmds.push_back({SymbolId(s), make_journal_record(JournalOp::Remove, id, 0)});
+        }
+    for (auto _ : state)
+    {
+        mgr.submit(cmds.data(), cmds.size());
+        mgr.sync();
+    }
+    mgr.stop();
+    state.SetItemsProcessed(state.iterations() * int64_t(cmds.size()));
+}
+
+// ---------------------------------------------------------------------------
+// Id lookup: 1M live order ids, each iteration a lookup of a live id or (50%) a
+// cancel + new order (release one id, intern a fresh one). BM_IdInterner is the book's
+// interner (HandleIndex); BM_UnorderedMapIds keeps the same ids in an
+// unordered_map<string, OrderHandle>, the id -> order map the book started from.
+// ---------------------------------------------------------------------------
+constexpr size_t kLiveIds = 1 << 20;
+
+struct IdChurn {
+    vector<string> pool; // 2 * kLiveIds ids: live[] indexes the ones on the book
+    vector<uint32_t> live, spare;
+    mt19937_64 rng{7};
+
+    IdChurn()
+    {
+        for (size_t i = 0; i < 2 * kLiveIds; ++i) pool.push_back("ORD-" + to_string(1000000000 + i * 7919));
+        for (uint32_t i = 0; i < kLiveIds; ++i)
+        {
+            live.push_back(i);
+            spare.push_back(uint32_t(kLiveIds) + i);
+        }
+    }
+};
+
+static void BM_IdInterner(benchmark::State &state)
+{
+    IdChurn c;
+    IdInterner ids;
+    ids.reserve(kLiveIds);
+    for (uint32_t k : c.live) ids.intern(c.pool[k]);
+    for (auto _ : state)
+    {
+        size_t i = c.rng() % kLiveIds;
+        if (c.rng() & 1)
+            benchmark::DoNotOptimize(ids.find(c.pool[c.live[i]]));
+        else
+        {
+            size_t j = c.rng() % kLiveIds;
+            ids.release(ids.find(c.pool[c.live[i]]));
+            ids.intern(c.pool[c.spare[j]]);
+            swap(c.live[i], c.spare[j]);
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+static void BM_UnorderedMapIds(benchmark::State &state)
+{
+    IdChurn c;
+    unordered_map<string, OrderHandle> ids;
+    ids.reserve(kLiveIds);
+    OrderHandle next = 0;
+    for (uint32_t k : c.live) ids.emplace(c.pool[k], next++);
+    for (auto _ : state)
+    {
+        size_t i = c.rng() % kLiveIds;
+        if (c.rng() & 1)
+            benchmark::DoNotOptimize(ids.find(c.pool[c.live[i]]));
+        else
+        {
+            size_t j = c.rng() % kLiveIds;
+            auto it = ids.find(c.pool[c.live[i]]);
+            OrderHandle h = it->second;
+            ids.erase(it);
+            ids.emplace(c.pool[c.spare[j]], h);
+            swap(c.live[i], c.spare[j]);
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+// ---------------------------------------------------------------------------
+// Cross-thread handoff: sustained commands/s from a producer to a consumer thread,
+// pinned to cpus 0 and 1 when there are two. range(0) is the producer batch size;
+// the consumer always drains whatever is queued. BM_MutexQueue is the same handoff
+// through a mutex-guarded deque, as callers did before BookManager had a ring.
+// ---------------------------------------------------------------------------
+constexpr size_t kHandoffMessages = 1 << 20;
+
+static void pin_pair(int cpu)
+{
+    if (thread::hardware_concurrency() > 1) pin_current_thread(cpu);
+}
+
+static void BM_SpscRing(benchmark::State &state)
+{
+    const size_t batch = size_t(state.range(0));
+    BookCommand proto{0, make_journal_record(JournalOp::Remove, "order-1", 0)};
+    vector<BookCommand> cmds(batch, proto);
+    pin_pair(0);
+    for (auto _ : state)
+    {
+        SpscRing<BookCommand> ring(4096);
+        uint64_t checksum = 0;
+        thread consumer([&] {
+            pin_pair(1);
+            for (size_t got = 0; got < kHandoffMessages;)
+            {
+                size_t n = ring.drain([&](const BookCommand *c, size_t k) { checksum += c[k - 1].op.id_len; });
+                if (!n) this_thread::yield();
+                got += n;
+            }
+        });
+        for (size_t sent = 0; sent < kHandoffMessages;)
+        {
+            size_t n = ring.try_push(cmds.data(), min(batch, kHandoffMessages - sent));
+            if (!n) this_thread::yield(); // full
+            sent += n;
+        }
+        consumer.join();
+        benchmark::DoNotOptimize(checksum);
+    }
+    state.SetItemsProcessed(state.iterations() * int64_t(kHandoffMessages));
+}
+
+static void BM_MutexQueue(benchmark::State &state)
+{
+    const size_t batch = size_t(state.range(0));
+    BookCommand proto{0, make_journal_record(JournalOp::Remove, "order-1", 0)};
+    pin_pair(0);
+    for (auto _ : state)
+    {
+        mutex mu;
+        deque<BookCommand> q;
+        uint64_t checksum = 0;
+        thread consumer([&] {
+            pin_pair(1);
+            for (size_t got = 0; got < kHandoffMessages;)
+            {
+                lock_guard<mutex> lk(mu);
+                for (; !q.empty(); q.pop_front(), ++got) checksum += q.front().op.id_len;
+            }
+        });
+        for (size_t sent = 0; sent < kHandoffMessages;)
+        {
+            size_t n = min(batch, kHandoffMessages - sent);
+            lock_guard<mutex> lk(mu);
+            for (size_t i = 0; i < n; ++i) q.push_back(proto);
+            sent += n;
+        }
+        consumer.join();
+        benchmark::DoNotOptimize(checksum);
+    }
+    state.SetItemsProcessed(state.iterations() * int64_t(kHandoffMessages));
+}
+
+#define OB_BENCH(fn)                                          \
+    BENCHMARK_TEMPLATE(fn, OrderBook)->Apply(BookArgs);       \
+    BENCHMARK_TEMPLATE(fn, LadderOrderBook)->Apply(BookArgs)
+
+OB_BENCH(BM_AddOrder);
+OB_BENCH(BM_RemoveOrder);
+OB_BENCH(BM_AmendPrice);
+OB_BENCH(BM_AmendQtyUp);
+OB_BENCH(BM_AmendQtyDown);
+OB_BENCH(BM_TopPrice);
+OB_BENCH(BM_OrdersAt);
+OB_BENCH(BM_OrdersOnSide);
+OB_BENCH(BM_ForEachOrderOnSide);
+OB_BENCH(BM_DepthSnapshot);
+OB_BENCH(BM_OrdersCreatedBeforeAfter);
+OB_BENCH(BM_CancelHeavy);
+OB_BENCH(BM_CancelHeavyL2Feed);
+OB_BENCH(BM_AmendHeavy);
+OB_BENCH(BM_TopOfBookChurn);
+OB_BENCH(BM_RandomSideFlow);
+OB_BENCH(BM_LoadSnapshot);
+OB_BENCH(BM_RebuildByAdds);
+BENCHMARK_TEMPLATE(BM_SparseTopCancel, OrderBook)->Arg(10)->Arg(1000);
+BENCHMARK_TEMPLATE(BM_SparseTopCancel, LadderOrderBook)->Arg(10)->Arg(1000);
+
+BENCHMARK_TEMPLATE(BM_PacketSingleCalls, OrderBook)->Apply(PacketArgs);
+BENCHMARK_TEMPLATE(BM_PacketBatch, OrderBook)->Apply(PacketArgs);
+BENCHMARK_TEMPLATE(BM_PacketSingleCalls, LadderOrderBook)->Apply(PacketArgs);
+BENCHMARK_TEMPLATE(BM_PacketBatch, LadderOrderBook)->Apply(PacketArgs);
+BENCHMARK_TEMPLATE(BM_SweepLevel, OrderBook)->Args({200, 8})->Args({200, 64});
+BENCHMARK_TEMPLATE(BM_SweepLevel, LadderOrderBook)->Args({200, 8})->Args({200, 64});
+BENCHMARK(BM_BookClock)->DenseRange(0, 3);
+BENCHMARK(BM_IdInterner);
+BENCHMARK(BM_UnorderedMapIds);
+BENCHMARK(BM_BboRead)->Arg(0)->Arg(1);
+BENCHMARK(BM_SpscRing)->Arg(1)->Arg(16)->Arg(256)->UseRealTime();
+BENCHMARK(BM_MutexQueue)->Arg(1)->Arg(16)->Arg(256)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_ManagerThroughput, OrderBook)->Arg(1)->Arg(2)->Arg(4)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_ManagerThroughput, LadderOrderBook)->Arg(1)->Arg(2)->Arg(4)->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -0,0 +1,54 @@
+#include <chrono>
+#include <iostream>
+#include "OrderBook.h"
+
+// --------------------------- Journal Replay Tool ----------------------------
+// Rebuilds a book from a journal written through OrderBook::attach_journal and prints
+// the resulting top of book and replay throughput.
+//
+//   ./journal_replay book.journal [--ladder]
+
+using namespace ob;
+
+template <class Book>
+static int replay(JournalReader &reader)
+{
+    Book book(Price::from_units(reader.header().tick_units));
+    vector<Fill> fills;
+    uint64_t rejected = 0;
+
+    auto start = chrono::steady_clock::now();
+    uint64_t n = reader.for_each([&](const JournalRecord &r) {
+        if (!book.apply(r, fills)) ++rejected;
+    });
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    cout << "records:  " << n << " (" << rejected << " rejected, as originally)\n";
+    if (secs > 0) cout << "replay:   " << secs * 1e3 << " ms, " << uint64_t(double(n) / secs) << " records/s\n";
+    for (Side s : {Side::Bid, Side::Ask})
+    {
+        cout << (s == Side::Bid ? "bids:     " : "asks:     ") << book.num_orders_on_side(s) << " orders, "
+             << book.num_price_levels(s) << " levels, qty " << book.quantity_on_side(s) << ", top ";
+        if (auto p = book.top_price(s)) cout << *p;
+        else cout << "(none)";
+        cout << "\n";
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        cerr << "usage: " << argv[0] << " <journal> [--ladder]\n";
+        return 2;
+    }
+    JournalReader reader;
+    if (!reader.open(argv[1]))
+    {
+        cerr << "cannot read journal " << argv[1] << "\n";
+        return 1;
+    }
+    if (argc > 2 && string(argv[2]) == "--ladder") return replay<LadderOrderBook>(reader);
+    return replay<OrderBook>(reader);
+}
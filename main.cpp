@@ -1,3 +1,4 @@
+#include "BookManager.h"
 #include "OrderBook.h"
 #include <iostream>
 // --------------------------- Demo / Quick Tests ----------------------------
@@ -15,16 +16,14 @@ void print_summary(const OrderBook &ob) {
 
 void print_side(const OrderBook &ob, Side s) {
     cout << (s == Side::Bid ? "Bids:\n" : "Asks:\n");
-    auto prices = ob.price_levels(s);
-    for (double p : prices) {
-        cout << "  Price " << p << " -> ";
-        auto orders = ob.orders_at(s, p);
-        for (auto &o : orders) {
-            cout << "[id=" << o->id << ", q=" << o->quantity << ", lu=" << time_to_string(o->last_update_time)
+    ob.for_each_level(s, [&](const PriceLevel &pl) {
+        cout << "  Price " << pl.price << " -> ";
+        ob.for_each_order_at(s, pl.price, [](const Order &o) {
+            cout << "[id=" << o.id << ", q=" << o.quantity << ", lu=" << time_to_string(o.last_update_time)
                  << "] ";
-        }
+        });
         cout << "\n";
-    }
+    });
 }
 
 int main() {
@@ -71,11 +70,13 @@ int main() {
     cout << "----\n";
 
     // Fully match example: receive Order 6 to sell 150 @ 50 (matches bids)
-    cout << "Simulating fill: Order 6 sells 150 @ 50 (manual simulation)\n";
-    // Remove order 4
-    ob.remove_order("4");
-    // Reduce order 1 from 500 to 450
-    ob.amend_order("2", optional<double>{50.0}, optional<uint64_t>{150});
+    cout << "Matching: Order 6 sells 150 @ 50\n";
+    // Hits order 4 (100 @ 51) in full, then 50 from order 2 (first in queue at 50)
+    vector<Fill> fills;
+    auto res = ob.add_and_match("6", Side::Ask, 50.0, 150, fills);
+    for (auto &f : fills)
+        cout << "  Fill: maker=" << f.maker_id << " q=" << f.quantity << " @ " << f.price << "\n";
+    cout << "  Filled " << res.filled << ", resting " << res.resting << "\n";
     print_side(ob, Side::Bid);
     print_side(ob, Side::Ask);
     cout << "----\n";
@@ -91,6 +92,24 @@ int main() {
              << " qty=" << (*o)->quantity << " created=" << time_to_string((*o)->creation_time) << "\n";
     }
     
+    // Per-operation latency (recorded only when built with -DOB_INSTRUMENT)
+    ob.dump_latency(cout);
+
+    // Many symbols: each book is owned by one worker thread
+    BookManager<OrderBook> mgr(2);
+    SymbolId abc = mgr.add_symbol(0.01), xyz = mgr.add_symbol(0.05);
+    mgr.on_fills([](SymbolId s, const vector<Fill> &f) {
+        cout << "  symbol " << s << ": " << f.size() << " fill(s), first maker=" << f[0].maker_id << "\n";
+    });
+    mgr.start();
+    mgr.add_order(abc, "a1", Side::Ask, 20.0, 100);
+    mgr.add_order(xyz, "x1", Side::Bid, 7.5, 50);
+    mgr.add_and_match(abc, "a2", Side::Bid, 20.0, 40);
+    mgr.sync();
+    mgr.stop();
+    cout << "Symbol " << abc << " asks: " << mgr.book(abc).quantity_on_side(Side::Ask) << ", symbol " << xyz
+         << " bids: " << mgr.book(xyz).quantity_on_side(Side::Bid) << "\n";
+
     cout << "Demo complete.\n";
     return 0;
 }
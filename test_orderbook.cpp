@@ -1,7 +1,12 @@
 #include <gtest/gtest.h>
+#include <random>
+#include <thread>
+#include <unistd.h>
+#include "BookManager.h"
 #include "OrderBook.h"
 
 using namespace std;
+using namespace ob;
 
 class OrderBookTest : public ::testing::Test {
 protected:
@@ -110,6 +115,30 @@ TEST_F(OrderBookTest, AmendQuantityIncreaseMovesToBack) {
     EXPECT_EQ(after[1]->id, "A");
 }
 
+TEST_F(OrderBookTest, AmendQuantityIncreaseRequeuesInPlace) {
+    ob.add_order("A", Side::Bid, 50, 100, tp(1));
+    ob.add_order("B", Side::Bid, 50, 100, tp(2));
+    ob.add_order("C", Side::Bid, 50, 100, tp(3));
+
+    ob.amend_order("B", nullopt, 150, tp(4)); // middle of the queue
+    ob.amend_order("B", nullopt, 200, tp(5)); // already last
+    ob.amend_order("A", nullopt, 120, tp(6)); // head
+    auto after = ob.orders_at(Side::Bid, 50);
+    ASSERT_EQ(after.size(), 3);
+    EXPECT_EQ(after[0]->id, "C");
+    EXPECT_EQ(after[1]->id, "B");
+    EXPECT_EQ(after[2]->id, "A");
+    EXPECT_EQ(ob.quantity_at(Side::Bid, 50), 420);
+    EXPECT_EQ(ob.quantity_on_side(Side::Bid), 420);
+
+    auto updated = ob.orders_updated_after(tp(0));
+    ASSERT_EQ(updated.size(), 3);
+    EXPECT_EQ(updated[0]->id, "C");
+    EXPECT_EQ(updated[1]->id, "B");
+    EXPECT_EQ(updated[2]->id, "A");
+    EXPECT_EQ(ob.orders_updated_before(tp(5)).size(), 1);
+}
+
 // -----------------------------------------------------------------------------
 // TOP/BOTTOM PRICE
 // -----------------------------------------------------------------------------
@@ -171,6 +200,120 @@ TEST_F(OrderBookTest, OrdersUpdatedBeforeAfter) {
     EXPECT_EQ(ob.orders_updated_after(tp(20)).size(), 1);
 }
 
+TEST_F(OrderBookTest, TimeQueriesAreOrderedAndTrackAmendsAndRemovals) {
+    ob.add_order("A", Side::Bid, 50, 10, tp(30));
+    ob.add_order("B", Side::Ask, 55, 10, tp(10));
+    ob.add_order("C", Side::Bid, 49, 10, tp(20));
+    ob.add_order("D", Side::Bid, 48, 10, tp(40));
+
+    auto before = ob.orders_created_before(tp(40));
+    ASSERT_EQ(before.size(), 3);
+    EXPECT_EQ(before[0]->id, "B");
+    EXPECT_EQ(before[1]->id, "C");
+    EXPECT_EQ(before[2]->id, "A");
+
+    ob.amend_order("B", nullopt, 20, tp(50));  // qty up: update time moves
+    ob.amend_order("C", nullopt, 5, tp(60));   // qty down: update time kept
+    ob.remove_order("D");
+
+    auto updated = ob.orders_updated_after(tp(15));
+    ASSERT_EQ(updated.size(), 3);
+    EXPECT_EQ(updated[0]->id, "C");
+    EXPECT_EQ(updated[1]->id, "A");
+    EXPECT_EQ(updated[2]->id, "B");
+    EXPECT_EQ(ob.orders_updated_before(tp(25)).size(), 1);
+    EXPECT_EQ(ob.orders_created_after(tp(30)).size(), 0);  // strict bound, D removed
+}
+
+// The time indexes' tree nodes come from a NodePool: churn reuses freed nodes
+TEST(NodePoolTest, SetNodesAreReusedAfterErase) {
+    using Key = pair<uint64_t, OrderHandle>; // the shape of a TimeIndex entry
+    auto pool = make_shared<NodePool>();
+    set<Key, less<Key>, NodePoolAllocator<Key>> a{less<Key>(), NodePoolAllocator<Key>(pool)};
+    set<Key, less<Key>, NodePoolAllocator<Key>> b{less<Key>(), a.get_allocator()};
+    for (OrderHandle h = 0; h < 300; ++h) {
+        a.emplace(h, h);
+        b.emplace(h, h);
+    }
+    const size_t cap = pool->capacity();
+    EXPECT_GE(cap, 600u);
+    for (OrderHandle h = 0; h < 100000; ++h) { // add / cancel churn at a steady size
+        a.erase(a.begin());
+        b.erase(b.begin());
+        a.emplace_hint(a.end(), 300 + h, h);
+        b.emplace_hint(b.end(), 300 + h, h);
+    }
+    EXPECT_EQ(pool->capacity(), cap);
+    EXPECT_EQ(a.size(), 300u);
+    EXPECT_EQ(a.begin()->first, 100000u);
+}
+
+// -----------------------------------------------------------------------------
+// BOOK CLOCK
+// -----------------------------------------------------------------------------
+TEST_F(OrderBookTest, BookStampsAreStrictlyIncreasingAndReadOnlyWhenRecorded) {
+    const auto tick = TimePoint::duration(1);
+    ob.set_clock(BookClock::Caller);
+    ob.set_time(tp(100));
+    ob.add_order("A", Side::Bid, 50, 10);
+    ob.add_order("B", Side::Bid, 50, 10); // same packet time: bumped one tick
+    EXPECT_EQ(ob.get_order("A").value()->creation_time, tp(100));
+    EXPECT_EQ(ob.get_order("B").value()->creation_time, tp(100) + tick);
+
+    ob.set_time(tp(90)); // caller time going back never inverts the book's times
+    ob.amend_order("A", nullopt, 20);
+    EXPECT_EQ(ob.get_order("A").value()->last_update_time, tp(100) + 2 * tick);
+    auto updated = ob.orders_updated_after(tp(0));
+    ASSERT_EQ(updated.size(), 2);
+    EXPECT_EQ(updated[0]->id, "B");
+    EXPECT_EQ(updated[1]->id, "A");
+
+    // explicit times are recorded as given; later book stamps continue after them
+    ob.set_clock(BookClock::Sequence);
+    ob.add_order("C", Side::Ask, 60, 10, tp(200));
+    ob.remove_order("B");             // no journal: nothing to stamp
+    ob.amend_order("A", nullopt, 20); // no-op: nothing to stamp
+    ob.add_order("D", Side::Ask, 60, 10);
+    EXPECT_EQ(ob.get_order("C").value()->creation_time, tp(200));
+    EXPECT_EQ(ob.get_order("D").value()->creation_time, tp(200) + tick);
+    vector<Fill> fills;
+    ob.add_and_match("E", Side::Bid, 60, 15, fills);
+    EXPECT_EQ(ob.last_transaction("D")->time, tp(200) + 2 * tick);
+
+    // rejected adds use up no stamp
+    EXPECT_FALSE(ob.add_order("F", Side::Ask, 60.001, 10)); // off the tick grid
+    EXPECT_FALSE(ob.add_order("D", Side::Ask, 61, 10));     // D is still resting
+    ob.add_order("G", Side::Ask, 61, 10);
+    EXPECT_EQ(ob.get_order("G").value()->creation_time, tp(200) + 3 * tick);
+
+    // a packet reads the clock once; its accepted mutations are stamped a tick apart
+    ob.set_clock(BookClock::Caller);
+    ob.set_time(tp(300));
+    BookMutation pkt[] = {{ob.intern("H"), JournalOp::Add, Side::Ask, 0, Price(62), 10},
+                          {ob.intern("G"), JournalOp::Add, Side::Ask, 0, Price(62), 10}, // rejected
+                          {ob.intern("A"), JournalOp::Amend, Side::Bid, kJournalHasQty, Price(), 5},
+                          {ob.intern("I"), JournalOp::Add, Side::Ask, 0, Price(63), 10}};
+    EXPECT_EQ(ob.apply_batch(pkt, 4, fills), 3u);
+    EXPECT_EQ(ob.get_order("H").value()->creation_time, tp(300));
+    EXPECT_EQ(ob.last_transaction("A")->time, tp(300) + tick);
+    EXPECT_EQ(ob.get_order("I").value()->creation_time, tp(300) + 2 * tick);
+    ob.add_order("J", Side::Ask, 63, 10); // same packet time: continues after the batch
+    EXPECT_EQ(ob.get_order("J").value()->creation_time, tp(300) + 3 * tick);
+}
+
+TEST_F(OrderBookTest, TscClockTracksWallTime) {
+    ob.set_clock(BookClock::Tsc);
+    TimePoint before = now_tp();
+    ob.add_order("A", Side::Bid, 50, 10);
+    ob.add_order("B", Side::Bid, 50, 10);
+    TimePoint after = now_tp();
+    TimePoint a = ob.get_order("A").value()->creation_time;
+    EXPECT_LT(a, ob.get_order("B").value()->creation_time);
+    // calibration error over a short run stays far below this
+    EXPECT_LT(abs(chrono::duration_cast<chrono::milliseconds>(a - before).count()), 50);
+    EXPECT_LT(abs(chrono::duration_cast<chrono::milliseconds>(after - a).count()), 50);
+}
+
 // -----------------------------------------------------------------------------
 // ORDER ITERATION
 // -----------------------------------------------------------------------------
@@ -198,3 +341,1026 @@ TEST_F(OrderBookTest, CrossedMarketDetection) {
     ob.amend_order("B", 50.0, 10);  // now 50 <= 50
     EXPECT_TRUE(ob.is_crossed());
 }
+
+// -----------------------------------------------------------------------------
+// CACHED AGGREGATES
+// -----------------------------------------------------------------------------
+TEST_F(OrderBookTest, LevelAndSideTotalsTrackEveryMutation) {
+    ob.add_order("A", Side::Bid, 50, 100);
+    ob.add_order("B", Side::Bid, 50, 200);
+    ob.add_order("C", Side::Bid, 49, 50);
+    EXPECT_EQ(ob.quantity_at(Side::Bid, 50), 300);
+    EXPECT_EQ(ob.num_orders_on_side(Side::Bid), 3);
+    EXPECT_EQ(ob.quantity_on_side(Side::Bid), 350);
+
+    ob.amend_order("A", nullopt, 60);   // qty down, keeps priority
+    EXPECT_EQ(ob.quantity_at(Side::Bid, 50), 260);
+    ob.amend_order("B", nullopt, 250);  // qty up
+    EXPECT_EQ(ob.quantity_at(Side::Bid, 50), 310);
+    ob.amend_order("C", 50.0, 40);      // price + qty
+    EXPECT_EQ(ob.quantity_at(Side::Bid, 50), 350);
+    EXPECT_EQ(ob.quantity_at(Side::Bid, 49), 0);
+    EXPECT_EQ(ob.quantity_on_side(Side::Bid), 350);
+
+    vector<Fill> fills;
+    ob.add_and_match("S", Side::Ask, 50, 100, fills);  // fills A (60) and 40 of B
+    EXPECT_EQ(ob.quantity_at(Side::Bid, 50), 250);
+    EXPECT_EQ(ob.num_orders_on_side(Side::Bid), 2);
+    EXPECT_EQ(ob.quantity_on_side(Side::Bid), 250);
+
+    ob.remove_order("B");
+    EXPECT_EQ(ob.num_orders_on_side(Side::Bid), 1);
+    EXPECT_EQ(ob.quantity_on_side(Side::Bid), 40);
+    EXPECT_EQ(ob.num_orders_on_side(Side::Ask), 0);
+}
+
+// -----------------------------------------------------------------------------
+// FIXED-POINT PRICES
+// -----------------------------------------------------------------------------
+TEST_F(OrderBookTest, SamePriceComputedDifferentlySharesLevel) {
+    ob.add_order("A", Side::Bid, 50.1, 10);
+    ob.add_order("B", Side::Bid, 50.0 + 0.1, 10);
+    ob.add_order("C", Side::Bid, 0.501 * 100, 10);
+
+    EXPECT_EQ(ob.num_price_levels(Side::Bid), 1);
+    EXPECT_EQ(ob.num_orders_at(Side::Bid, 50.1), 3);
+    EXPECT_EQ(ob.top_price(Side::Bid)->units, 501 * Price::scale / 10);
+}
+
+TEST_F(OrderBookTest, PricesOffTheTickGridAreRejected) {
+    OrderBook coarse(0.05);
+    EXPECT_FALSE(coarse.add_order("A", Side::Bid, 50.01, 10));
+    EXPECT_TRUE(coarse.add_order("A", Side::Bid, 50.05, 10));
+    EXPECT_FALSE(coarse.amend_order("A", 50.07, 10));
+    EXPECT_TRUE(coarse.amend_order("A", 50.10, 10));
+    EXPECT_EQ(coarse.top_price(Side::Bid), 50.10);
+}
+
+TEST_F(OrderBookTest, TickBelowOnePriceUnitIsClampedToOneUnit) {
+    OrderBook fine(0.00001); // rounds to 0 units at 4 decimals
+    EXPECT_EQ(fine.tick_size().units, 1);
+    EXPECT_TRUE(fine.add_order("A", Side::Bid, 50.0001, 10));
+    LadderOrderBook lfine(-0.01);
+    EXPECT_EQ(lfine.tick_size().units, 1);
+    EXPECT_TRUE(lfine.add_order("A", Side::Ask, 50.0001, 10));
+    EXPECT_EQ(lfine.top_price(Side::Ask), 50.0001);
+}
+
+// -----------------------------------------------------------------------------
+// ORDER HANDLES
+// -----------------------------------------------------------------------------
+TEST_F(OrderBookTest, HandleApiWorksWithoutStrings) {
+    OrderHandle a = ob.intern("A");
+    OrderHandle b = ob.intern("B");
+    EXPECT_NE(a, b);
+    EXPECT_EQ(ob.intern("A"), a);
+
+    EXPECT_TRUE(ob.add_order(a, Side::Bid, 50, 100));
+    EXPECT_TRUE(ob.add_order(b, Side::Bid, 50, 100));
+    EXPECT_FALSE(ob.add_order(a, Side::Bid, 51, 100)); // already live
+
+    EXPECT_EQ(ob.find_handle("A"), a);
+    EXPECT_EQ((*ob.get_order(a))->id, "A");
+    EXPECT_EQ(ob.order_id(b), "B");
+
+    EXPECT_TRUE(ob.amend_order(a, 50.0, 200));
+    auto orders = ob.orders_at(Side::Bid, 50);
+    EXPECT_EQ(orders[0]->handle, b);
+    EXPECT_EQ(orders[1]->handle, a);
+
+    EXPECT_TRUE(ob.remove_order(a));
+    EXPECT_FALSE(ob.remove_order(a));
+    EXPECT_EQ(ob.find_handle("A"), kInvalidHandle);
+    EXPECT_FALSE(ob.add_order(a, Side::Bid, 50, 100)); // released handles are not usable
+}
+
+TEST_F(OrderBookTest, HandlesAreReusedAfterRemoval) {
+    ob.add_order("A", Side::Bid, 50, 100);
+    OrderHandle a = ob.find_handle("A");
+    ob.remove_order("A");
+
+    ob.add_order("C", Side::Ask, 55, 100);
+    EXPECT_EQ(ob.find_handle("C"), a);
+    EXPECT_FALSE(ob.get_order("A").has_value());
+    EXPECT_EQ((*ob.get_order("C"))->id, "C");
+}
+
+// An OrderRef reads the live order (hot node and cold info) on every access
+TEST_F(OrderBookTest, OrderRefSeesLaterChangesToHotAndColdFields) {
+    ob.add_order("A", Side::Bid, 50, 100, tp(1));
+    OrderRef a = *ob.get_order("A");
+    ob.amend_order("A", 51.0, 80, tp(2));
+    EXPECT_EQ(a->price, 51);
+    EXPECT_EQ(a->quantity, 80);
+    EXPECT_EQ(a->creation_time, tp(1));
+    EXPECT_EQ(a->last_update_time, tp(2));
+    EXPECT_EQ(a->last_txn.type, TxnType::Amend);
+
+    vector<Fill> fills;
+    ob.add_and_match("S", Side::Ask, 51, 30, fills, tp(3));
+    Order o = *a;
+    EXPECT_EQ(o.quantity, 50);
+    EXPECT_EQ(o.last_txn.type, TxnType::Fill);
+    EXPECT_EQ(ob.last_transaction("A")->time, tp(3));
+}
+
+TEST_F(OrderBookTest, RejectedOrFilledIdsAreNotKeptInterned) {
+    EXPECT_FALSE(ob.add_order("A", Side::Bid, 50.001, 100)); // off tick
+    EXPECT_EQ(ob.find_handle("A"), kInvalidHandle);
+
+    ob.add_order("B", Side::Ask, 50, 100);
+    vector<Fill> fills;
+    ob.add_and_match("C", Side::Bid, 50, 100, fills);
+    EXPECT_EQ(ob.find_handle("B"), kInvalidHandle);
+    EXPECT_EQ(ob.find_handle("C"), kInvalidHandle);
+}
+
+// -----------------------------------------------------------------------------
+// MATCHING
+// -----------------------------------------------------------------------------
+TEST_F(OrderBookTest, MatchWalksLevelsInPriceThenTimeOrder) {
+    ob.add_order("A", Side::Bid, 50, 100);
+    ob.add_order("B", Side::Bid, 50, 100);
+    ob.add_order("C", Side::Bid, 51, 100);
+
+    vector<Fill> fills;
+    auto res = ob.add_and_match("S", Side::Ask, 50, 250, fills);
+
+    EXPECT_TRUE(res.accepted);
+    EXPECT_EQ(res.filled, 250);
+    EXPECT_EQ(res.resting, 0);
+    ASSERT_EQ(fills.size(), 3);
+    EXPECT_EQ(fills[0].maker_id, "C");
+    EXPECT_EQ(fills[0].price, 51);
+    EXPECT_EQ(fills[1].maker_id, "A");
+    EXPECT_EQ(fills[2].maker_id, "B");
+    EXPECT_EQ(fills[2].quantity, 50);
+    EXPECT_EQ(fills[0].maker_remaining, 0);
+    EXPECT_EQ(fills[2].maker_remaining, 50);
+
+    // A and C gone, B partially filled and still resting
+    EXPECT_FALSE(ob.get_order("A").has_value());
+    EXPECT_FALSE(ob.get_order("C").has_value());
+    EXPECT_EQ((*ob.get_order("B"))->quantity, 50);
+    EXPECT_EQ(ob.last_transaction("B")->type, TxnType::Fill);
+    EXPECT_FALSE(ob.get_order("S").has_value());
+    EXPECT_EQ(ob.num_price_levels(Side::Bid), 1);
+}
+
+TEST_F(OrderBookTest, MatchRestsRemainderAndStopsAtLimit) {
+    ob.add_order("A", Side::Ask, 55, 100);
+    ob.add_order("B", Side::Ask, 57, 100);
+
+    vector<Fill> fills;
+    auto res = ob.add_and_match("X", Side::Bid, 56, 300, fills);
+
+    EXPECT_EQ(res.filled, 100);
+    EXPECT_EQ(res.resting, 200);
+    ASSERT_EQ(fills.size(), 1);
+    EXPECT_EQ(ob.top_price(Side::Bid), 56);
+    EXPECT_EQ(ob.top_price(Side::Ask), 57);
+    EXPECT_EQ((*ob.get_order("X"))->quantity, 200);
+    EXPECT_FALSE(ob.is_crossed());
+}
+
+TEST_F(OrderBookTest, MatchRejectsDuplicateID) {
+    ob.add_order("A", Side::Ask, 55, 100);
+    vector<Fill> fills;
+    EXPECT_FALSE(ob.add_and_match("A", Side::Bid, 55, 10, fills).accepted);
+    EXPECT_TRUE(fills.empty());
+    EXPECT_EQ((*ob.get_order("A"))->quantity, 100);
+}
+
+// -----------------------------------------------------------------------------
+// VISITOR QUERIES
+// -----------------------------------------------------------------------------
+TEST_F(OrderBookTest, VisitorsWalkInPriorityOrderAndStopEarly) {
+    ob.add_order("A", Side::Bid, 50, 100);
+    ob.add_order("B", Side::Bid, 51, 200);
+    ob.add_order("C", Side::Bid, 50, 300);
+
+    vector<Price> prices;
+    ob.for_each_level(Side::Bid, [&](const PriceLevel &pl) { prices.push_back(pl.price); });
+    EXPECT_EQ(prices, ob.price_levels(Side::Bid));
+
+    string ids;
+    ob.for_each_order_on_side(Side::Bid, [&](const Order &o) { ids += o.id; });
+    EXPECT_EQ(ids, "BAC");
+
+    ids.clear();
+    ob.for_each_order_at(Side::Bid, 50, [&](const Order &o) {
+        ids += o.id;
+        return false; // first order only
+    });
+    EXPECT_EQ(ids, "A");
+
+    ids.clear();
+    ob.for_each_order_at(Side::Ask, 50, [&](const Order &o) { ids += o.id; });
+    EXPECT_TRUE(ids.empty());
+
+    ids.clear();
+    auto c = *ob.get_order("C");
+    ob.for_each_created_before(c->creation_time, [&](const Order &o) { ids += o.id; });
+    ob.for_each_created_after(c->creation_time - chrono::hours(1), [&](const Order &o) {
+        ids += o.id;
+        return o.id != "B";
+    });
+    EXPECT_EQ(ids.substr(ids.size() - 2), "AB");
+}
+
+TEST_F(OrderBookTest, DepthSnapshotReportsTopLevelsFromAggregates) {
+    ob.add_order("A", Side::Bid, 50, 100);
+    ob.add_order("B", Side::Bid, 50, 200);
+    ob.add_order("C", Side::Bid, 49, 50);
+    ob.add_order("D", Side::Bid, 48, 10);
+    ob.add_order("E", Side::Ask, 55, 70);
+    ob.amend_order("B", nullopt, 150);
+
+    DepthSnapshot<2> snap;
+    ob.depth(snap);
+    ASSERT_EQ(snap.bid_levels, 2);
+    EXPECT_EQ(snap.bids[0].price, 50);
+    EXPECT_EQ(snap.bids[0].quantity, 250);
+    EXPECT_EQ(snap.bids[0].count, 2);
+    EXPECT_EQ(snap.bids[1].price, 49);
+    EXPECT_EQ(snap.bids[1].quantity, 50);
+    ASSERT_EQ(snap.ask_levels, 1);
+    EXPECT_EQ(snap.asks[0].price, 55);
+    EXPECT_EQ(snap.asks[0].count, 1);
+
+    LevelSummary none[1];
+    EXPECT_EQ(ob.depth(Side::Bid, none, 0), 0);
+    ob.remove_order("E");
+    ob.depth(snap);
+    EXPECT_EQ(snap.ask_levels, 0);
+}
+
+// -----------------------------------------------------------------------------
+// L2 DELTA FEED
+// -----------------------------------------------------------------------------
+static vector<L2Update> drain_all(EventRing<L2Update> &feed) {
+    vector<L2Update> out;
+    feed.drain([&](const L2Update *ev, size_t n) { out.insert(out.end(), ev, ev + n); });
+    return out;
+}
+
+TEST_F(OrderBookTest, L2FeedEmitsLevelAndTopOfBookEvents) {
+    ob.add_order("A", Side::Bid, 50, 100);
+    ob.enable_l2_feed(64);
+
+    ob.add_order("B", Side::Bid, 51, 10); // new best level
+    auto ev = drain_all(ob.l2_feed());
+    ASSERT_EQ(ev.size(), 2);
+    EXPECT_EQ(ev[0].type, L2Event::NewLevel);
+    EXPECT_EQ(ev[0].level.price, 51);
+    EXPECT_EQ(ev[1].type, L2Event::TopOfBook);
+    EXPECT_EQ(ev[1].side, Side::Bid);
+    EXPECT_EQ(ev[1].level.quantity, 10);
+
+    ob.amend_order("A", nullopt, 60); // below the touch: no top-of-book event
+    ev = drain_all(ob.l2_feed());
+    ASSERT_EQ(ev.size(), 1);
+    EXPECT_EQ(ev[0].type, L2Event::LevelChanged);
+    EXPECT_EQ(ev[0].level.quantity, 60);
+
+    ob.remove_order("B");
+    ev = drain_all(ob.l2_feed());
+    ASSERT_EQ(ev.size(), 2);
+    EXPECT_EQ(ev[0].type, L2Event::LevelDeleted);
+    EXPECT_EQ(ev[0].level.count, 0);
+    EXPECT_EQ(ev[1].type, L2Event::TopOfBook);
+    EXPECT_EQ(ev[1].level.price, 50);
+
+    vector<Fill> fills;
+    ob.add_and_match("S", Side::Ask, 50, 60, fills); // sweeps the bid side empty
+    ev = drain_all(ob.l2_feed());
+    ASSERT_EQ(ev.size(), 2);
+    EXPECT_EQ(ev[0].type, L2Event::LevelDeleted);
+    EXPECT_EQ(ev[1].type, L2Event::TopOfBook);
+    EXPECT_EQ(ev[1].level.count, 0);
+}
+
+TEST_F(OrderBookTest, L2FeedCountsDroppedEventsWhenFull) {
+    ob.enable_l2_feed(2);
+    ob.add_order("A", Side::Bid, 50, 100);
+    ob.add_order("B", Side::Ask, 55, 100);
+    EXPECT_EQ(ob.l2_feed().size(), 2);
+    EXPECT_EQ(ob.l2_feed().dropped(), 2);
+}
+
+// Replaying the feed onto an empty shadow book reproduces the book's depth
+TEST(L2FeedTest, ReplayMatchesDepthOnRandomFlow) {
+    LadderOrderBook lb(0.01);
+    lb.enable_l2_feed(1 << 12);
+    map<pair<Side, int64_t>, LevelSummary> shadow;
+    LevelSummary top[2]{};
+    auto apply = [&](const L2Update *ev, size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+            auto key = make_pair(ev[i].side, ev[i].level.price.units);
+            switch (ev[i].type) {
+                case L2Event::NewLevel: EXPECT_FALSE(shadow.count(key)); shadow[key] = ev[i].level; break;
+                case L2Event::LevelChanged: EXPECT_TRUE(shadow.count(key)); shadow[key] = ev[i].level; break;
+                case L2Event::LevelDeleted: EXPECT_EQ(shadow.erase(key), 1); break;
+                case L2Event::TopOfBook: top[int(ev[i].side)] = ev[i].level; break;
+            }
+        }
+    };
+
+    mt19937 rng(11);
+    vector<string> live;
+    vector<Fill> fills;
+    for (int i = 0; i < 5000; ++i) {
+        int op = rng() % 10;
+        double price = (4950 + int(rng() % 100)) / 100.0;
+        uint64_t qty = 1 + rng() % 100;
+        Side side = (rng() & 1) ? Side::Bid : Side::Ask;
+        if (op < 4 || live.empty()) {
+            live.push_back(to_string(i));
+            lb.add_order(live.back(), side, price, qty);
+        } else if (op < 7) {
+            size_t k = rng() % live.size();
+            lb.remove_order(live[k]);
+            live[k] = live.back();
+            live.pop_back();
+        } else if (op < 9) {
+            lb.amend_order(live[rng() % live.size()], (rng() & 1) ? optional<double>(price) : nullopt, qty);
+        } else if (lb.add_and_match(to_string(i), side, price, qty, fills).resting) {
+            live.push_back(to_string(i));
+        }
+        live.erase(remove_if(live.begin(), live.end(), [&](const string &id) { return !lb.get_order(id); }),
+                   live.end());
+        lb.l2_feed().drain(apply);
+    }
+    ASSERT_EQ(lb.l2_feed().dropped(), 0);
+
+    for (Side s : {Side::Bid, Side::Ask}) {
+        LevelSummary buf[256];
+        size_t n = lb.depth(s, buf, 256);
+        vector<LevelSummary> levels;
+        for (auto &kv : shadow)
+            if (kv.first.first == s) levels.push_back(kv.second);
+        if (s == Side::Bid) reverse(levels.begin(), levels.end());
+        ASSERT_EQ(levels.size(), n);
+        for (size_t i = 0; i < n; ++i) {
+            EXPECT_EQ(levels[i].price, buf[i].price);
+            EXPECT_EQ(levels[i].quantity, buf[i].quantity);
+            EXPECT_EQ(levels[i].count, buf[i].count);
+        }
+        EXPECT_EQ(top[int(s)].price, n ? buf[0].price : Price());
+        EXPECT_EQ(top[int(s)].quantity, n ? buf[0].quantity : 0);
+    }
+}
+
+// -----------------------------------------------------------------------------
+// PUBLISHED BBO
+// -----------------------------------------------------------------------------
+TEST_F(OrderBookTest, BboIsRepublishedOnlyWhenTheTouchMoves) {
+    EXPECT_EQ(ob.bbo().bid.count, 0u);
+    ob.add_order("A", Side::Bid, 50, 100);
+    ob.add_order("B", Side::Ask, 52, 30);
+    Bbo b = ob.bbo();
+    EXPECT_EQ(b.bid.price, 50);
+    EXPECT_EQ(b.bid.quantity, 100);
+    EXPECT_EQ(b.ask.price, 52);
+    EXPECT_EQ(b.ask.count, 1u);
+    EXPECT_FALSE(b.crossed());
+
+    uint64_t v = ob.bbo_version();
+    ob.add_order("C", Side::Bid, 49, 10); // behind the touch
+    EXPECT_EQ(ob.bbo_version(), v);
+    ob.add_order("D", Side::Ask, 52, 20); // joins the best ask
+    EXPECT_GT(ob.bbo_version(), v);
+    EXPECT_EQ(ob.bbo().ask.quantity, 50);
+    EXPECT_EQ(ob.bbo().ask.count, 2u);
+
+    vector<Fill> fills;
+    ob.add_and_match("E", Side::Ask, 50, 100, fills); // takes out the best bid
+    EXPECT_EQ(ob.bbo().bid.price, 49);
+    ob.remove_order("C");
+    EXPECT_EQ(ob.bbo().bid.count, 0u);
+}
+
+// A reader thread polling the BBO while the book churns must only ever see states the
+// writer published: every order is 10 lots, so quantity == 10 * count on each side,
+// and the book is never crossed
+TEST(BboTest, ConcurrentReadersSeeConsistentSnapshots) {
+    LadderOrderBook book(0.01);
+    atomic<bool> done{false};
+    uint64_t reads = 0, torn = 0;
+    thread reader([&] {
+        while (!done.load(memory_order_acquire)) {
+            Bbo b = book.bbo();
+            ++reads;
+            torn += b.bid.quantity != 10 * b.bid.count || b.ask.quantity != 10 * b.ask.count || b.crossed();
+        }
+    });
+    mt19937 rng(7);
+    for (int i = 0; i < 50000; ++i) {
+        string id = to_string(i % 64);
+        if (book.find_handle(id) != kInvalidHandle) book.remove_order(id);
+        else if (i % 2) book.add_order(id, Side::Bid, 10 + int(rng() % 5) / 100.0, 10);
+        else book.add_order(id, Side::Ask, 10.05 + int(rng() % 5) / 100.0, 10);
+    }
+    done.store(true, memory_order_release);
+    reader.join();
+    EXPECT_GT(reads, 0u);
+    EXPECT_EQ(torn, 0u);
+    EXPECT_EQ(book.bbo().bid.price, book.top_price(Side::Bid).value_or(Price()));
+}
+
+// -----------------------------------------------------------------------------
+// JOURNAL
+// -----------------------------------------------------------------------------
+TEST(JournalTest, ReplayRebuildsIdenticalBook) {
+    const string path = testing::TempDir() + "ob_journal_test.bin";
+    OrderBook live(0.01);
+    JournalWriter w;
+    ASSERT_TRUE(w.open(path, live.tick_size().units));
+    live.attach_journal(&w);
+
+    mt19937 rng(5);
+    vector<string> ids;
+    vector<Fill> fills;
+    for (int i = 0; i < 20000; ++i) { // several writer blocks
+        int op = rng() % 10;
+        double price = (4950 + int(rng() % 100)) / 100.0;
+        Side side = (rng() & 1) ? Side::Bid : Side::Ask;
+        if (op < 4 || ids.empty()) {
+            ids.push_back(to_string(i));
+            live.add_order(ids.back(), side, price, 1 + rng() % 100);
+        } else if (op < 6) {
+            live.remove_order(ids[rng() % ids.size()]);
+        } else if (op < 8) {
+            live.amend_order(ids[rng() % ids.size()], (rng() & 1) ? optional<double>(price) : nullopt,
+                             1 + rng() % 100);
+        } else {
+            ids.push_back(to_string(i));
+            live.add_and_match(ids.back(), side, price, 1 + rng() % 100, fills);
+        }
+    }
+    w.close();
+
+    JournalReader reader;
+    ASSERT_TRUE(reader.open(path));
+    OrderBook replayed(Price::from_units(reader.header().tick_units));
+    EXPECT_EQ(reader.for_each([&](const JournalRecord &r) { EXPECT_TRUE(replayed.apply(r, fills)); }),
+              w.records());
+
+    for (Side s : {Side::Bid, Side::Ask}) {
+        auto a = live.orders_on_side(s);
+        auto b = replayed.orders_on_side(s);
+        ASSERT_EQ(a.size(), b.size());
+        for (size_t i = 0; i < a.size(); ++i) {
+            EXPECT_EQ(a[i]->id, b[i]->id);
+            EXPECT_EQ(a[i]->price, b[i]->price);
+            EXPECT_EQ(a[i]->quantity, b[i]->quantity);
+            EXPECT_EQ(a[i]->creation_time, b[i]->creation_time);
+            EXPECT_EQ(a[i]->last_update_time, b[i]->last_update_time);
+        }
+    }
+    remove(path.c_str());
+}
+
+TEST(JournalTest, OverlongIdsAreRejectedOnlyWhenJournaling) {
+    const string path = testing::TempDir() + "ob_journal_long.bin";
+    const string long_id(kJournalMaxId + 1, 'x');
+    OrderBook book;
+    EXPECT_TRUE(book.add_order(long_id, Side::Bid, 50, 10));
+
+    JournalWriter w;
+    ASSERT_TRUE(w.open(path, book.tick_size().units));
+    book.attach_journal(&w);
+    vector<Fill> fills;
+    EXPECT_FALSE(book.add_order(long_id + "y", Side::Bid, 50, 10));
+    EXPECT_FALSE(book.add_and_match(long_id + "z", Side::Ask, 50, 10, fills).accepted);
+    EXPECT_EQ(book.find_handle(long_id + "y"), kInvalidHandle);
+    EXPECT_TRUE(book.add_order(string(kJournalMaxId, 'k'), Side::Bid, 49, 10));
+    w.close();
+    EXPECT_EQ(w.records(), 1);
+    remove(path.c_str());
+}
+
+TEST(JournalTest, UnknownHandlesAreRejectedWhileJournaling) {
+    const string path = testing::TempDir() + "ob_journal_handles.bin";
+    OrderBook book;
+    JournalWriter w;
+    ASSERT_TRUE(w.open(path, book.tick_size().units));
+    book.attach_journal(&w);
+    vector<Fill> fills;
+    EXPECT_FALSE(book.add_order(kInvalidHandle, Side::Bid, 50, 10));
+    EXPECT_FALSE(book.add_and_match(kInvalidHandle, Side::Bid, 50, 10, fills).accepted);
+
+    OrderHandle stale = book.intern("A");
+    ASSERT_TRUE(book.add_order(stale, Side::Bid, 50, 10));
+    ASSERT_TRUE(book.remove_order(stale)); // releases the handle
+    EXPECT_FALSE(book.add_order(stale, Side::Bid, 50, 10));
+    EXPECT_FALSE(book.add_order(OrderHandle(stale + 1000), Side::Bid, 50, 10)); // never issued
+    EXPECT_EQ(book.num_orders_on_side(Side::Bid), 0u);
+    w.close();
+    EXPECT_EQ(w.records(), 2);
+    remove(path.c_str());
+}
+
+// -----------------------------------------------------------------------------
+// SNAPSHOTS
+// -----------------------------------------------------------------------------
+template <class Book>
+static void expect_same_book(const Book &a, const Book &b) {
+    for (Side s : {Side::Bid, Side::Ask}) {
+        ASSERT_EQ(a.price_levels(s), b.price_levels(s));
+        EXPECT_EQ(a.quantity_on_side(s), b.quantity_on_side(s));
+        auto x = a.orders_on_side(s);
+        auto y = b.orders_on_side(s);
+        ASSERT_EQ(x.size(), y.size());
+        for (size_t i = 0; i < x.size(); ++i) {
+            EXPECT_EQ(x[i]->id, y[i]->id);
+            EXPECT_EQ(x[i]->quantity, y[i]->quantity);
+            EXPECT_EQ(x[i]->creation_time, y[i]->creation_time);
+            EXPECT_EQ(x[i]->last_update_time, y[i]->last_update_time);
+            EXPECT_EQ(x[i]->last_txn.type, y[i]->last_txn.type);
+            EXPECT_EQ(x[i]->last_txn.time, y[i]->last_txn.time);
+        }
+    }
+}
+
+template <class Book>
+static void snapshot_round_trip() {
+    const string path = testing::TempDir() + "ob_snapshot_test.bin";
+    Book a(0.01);
+    mt19937 rng(3);
+    vector<Fill> fills;
+    for (int i = 0; i < 3000; ++i) {
+        double price = (4950 + int(rng() % 100)) / 100.0;
+        Side side = (rng() & 1) ? Side::Bid : Side::Ask;
+        // quantities include 0: the book rejects it as the loader does, so every book
+        // it saves can be loaded back
+        if (i % 5 == 4) a.amend_order(to_string(rng() % i), nullopt, rng() % 50);
+        else a.add_and_match(to_string(i), side, price, rng() % 100, fills);
+    }
+    EXPECT_FALSE(a.add_order("zero", Side::Bid, 49.5, 0));
+    EXPECT_FALSE(a.amend_order(string(a.orders_on_side(Side::Bid)[0]->id), nullopt, 0));
+    ASSERT_TRUE(a.save_snapshot(path));
+
+    Book b(0.01);
+    ASSERT_TRUE(b.load_snapshot(path));
+    expect_same_book(a, b);
+    TimePoint mid = a.orders_on_side(Side::Bid)[0]->last_update_time;
+    EXPECT_EQ(a.orders_updated_before(mid).size(), b.orders_updated_before(mid).size());
+    EXPECT_EQ(a.orders_created_after(mid).size(), b.orders_created_after(mid).size());
+
+    // the loaded book keeps working like the original
+    string id(a.orders_on_side(Side::Ask)[0]->id);
+    EXPECT_TRUE(a.remove_order(id));
+    EXPECT_TRUE(b.remove_order(id));
+    TimePoint t = now_tp();
+    a.add_and_match("x", Side::Bid, 50.5, 500, fills, t);
+    b.add_and_match("x", Side::Bid, 50.5, 500, fills, t);
+    expect_same_book(a, b);
+
+    EXPECT_FALSE(b.load_snapshot(path)); // not empty
+    Book c(0.05);
+    EXPECT_FALSE(c.load_snapshot(path)); // different tick
+    remove(path.c_str());
+}
+
+TEST(SnapshotTest, RoundTripMapBackend) { snapshot_round_trip<OrderBook>(); }
+TEST(SnapshotTest, RoundTripLadderBackend) { snapshot_round_trip<LadderOrderBook>(); }
+
+TEST(SnapshotTest, TruncatedFileLeavesBookUnchanged) {
+    const string path = testing::TempDir() + "ob_snapshot_bad.bin";
+    OrderBook a;
+    a.add_order("A", Side::Bid, 50, 100);
+    a.add_order("B", Side::Bid, 49, 100);
+    ASSERT_TRUE(a.save_snapshot(path));
+    ASSERT_EQ(truncate(path.c_str(), sizeof(SnapshotHeader) + sizeof(SnapshotOrder) + 1 + 10), 0);
+
+    OrderBook b;
+    EXPECT_FALSE(b.load_snapshot(path));
+    EXPECT_EQ(b.num_orders_on_side(Side::Bid), 0);
+    EXPECT_EQ(b.find_handle("A"), kInvalidHandle);
+    EXPECT_FALSE(b.load_snapshot(path + ".missing"));
+    remove(path.c_str());
+}
+
+// -----------------------------------------------------------------------------
+// BATCHES
+// -----------------------------------------------------------------------------
+// Packets applied with apply_batch end in the same book, results and fills as the same
+// mutations applied one call at a time, with at most one TopOfBook per side per packet
+TEST(BatchTest, MatchesOneCallAtATimeAndPublishesTopOncePerBatch) {
+    LadderOrderBook single(0.01), batched(0.01);
+    batched.enable_l2_feed(1 << 16);
+    mt19937 rng(11);
+    vector<Fill> batch_fills, one;
+    for (int packet = 0; packet < 300; ++packet) {
+        TimePoint t = chrono::system_clock::time_point(chrono::seconds(packet));
+        vector<BookMutation> cmds(1 + rng() % 30);
+        vector<string> ids;
+        for (auto &m : cmds) {
+            ids.push_back("o" + to_string(rng() % 80));
+            m.handle = batched.intern(ids.back());
+            m.side = rng() % 2 ? Side::Bid : Side::Ask;
+            m.price = Price(((m.side == Side::Bid ? 4990 : 5000) + int(rng() % 20)) / 100.0);
+            m.quantity = 1 + rng() % 50;
+            switch (rng() % 5) {
+                case 0: case 1: m.op = JournalOp::Add; break;
+                case 2: m.op = JournalOp::AddMatch; break;
+                case 3: m.op = JournalOp::Amend; m.flags = uint8_t(1 + rng() % 3); break;
+                default: m.op = JournalOp::Remove; break;
+            }
+        }
+        // the one-at-a-time book goes by id, so an id cancelled earlier in the packet is
+        // interned again when it is re-added
+        vector<pair<string, uint64_t>> fills;
+        vector<char> expect;
+        for (size_t i = 0; i < cmds.size(); ++i) {
+            const BookMutation &m = cmds[i];
+            bool r = false;
+            switch (m.op) {
+                case JournalOp::Add: r = single.add_order(ids[i], m.side, m.price, m.quantity, t); break;
+                case JournalOp::AddMatch:
+                    r = single.add_and_match(ids[i], m.side, m.price, m.quantity, one, t).accepted;
+                    for (const Fill &f : one) fills.emplace_back(string(f.maker_id), f.quantity);
+                    break;
+                case JournalOp::Amend:
+                    r = single.amend_order(ids[i], (m.flags & kJournalHasPrice) ? optional<Price>(m.price) : nullopt,
+                                           (m.flags & kJournalHasQty) ? optional<uint64_t>(m.quantity) : nullopt, t);
+                    break;
+                default: r = single.remove_order(ids[i], t); break;
+            }
+            expect.push_back(r);
+        }
+        unique_ptr<bool[]> ok(new bool[cmds.size()]);
+        size_t accepted = batched.apply_batch(cmds.data(), cmds.size(), batch_fills, ok.get(), t);
+        EXPECT_EQ(accepted, size_t(count(expect.begin(), expect.end(), 1)));
+        for (size_t i = 0; i < cmds.size(); ++i) EXPECT_EQ(ok[i], bool(expect[i]));
+        ASSERT_EQ(batch_fills.size(), fills.size());
+        for (size_t i = 0; i < fills.size(); ++i) {
+            EXPECT_EQ(batch_fills[i].maker_id, fills[i].first);
+            EXPECT_EQ(batch_fills[i].quantity, fills[i].second);
+        }
+
+        int tops[2] = {0, 0};
+        batched.l2_feed().drain([&](const L2Update *ev, size_t n) {
+            for (size_t i = 0; i < n; ++i) tops[int(ev[i].side)] += ev[i].type == L2Event::TopOfBook;
+        });
+        EXPECT_LE(tops[0], 1);
+        EXPECT_LE(tops[1], 1);
+    }
+    expect_same_book(single, batched);
+    Bbo b = batched.bbo();
+    EXPECT_EQ(b.bid.price, single.top_price(Side::Bid).value_or(Price()));
+    EXPECT_EQ(b.ask.price, single.top_price(Side::Ask).value_or(Price()));
+}
+
+// A packet may cancel an id and add it again: the handle stays interned until the end
+TEST(BatchTest, CancelAndReAddOfTheSameIdInOnePacket) {
+    OrderBook book;
+    vector<Fill> fills;
+    OrderHandle a = book.intern("A");
+    ASSERT_TRUE(book.add_order(a, Side::Bid, 50, 10));
+    BookMutation pkt[] = {{a, JournalOp::Remove, Side::Bid, 0, Price(), 0},
+                          {a, JournalOp::Add, Side::Bid, 0, Price(49), 20}};
+    bool ok[2];
+    EXPECT_EQ(book.apply_batch(pkt, 2, fills, ok), 2u);
+    EXPECT_TRUE(ok[0]);
+    EXPECT_TRUE(ok[1]);
+    ASSERT_TRUE(book.get_order("A").has_value());
+    EXPECT_EQ(book.get_order("A").value()->price, 49);
+    EXPECT_EQ(book.get_order("A").value()->quantity, 20u);
+    EXPECT_EQ(book.find_handle("A"), a);
+
+    // a cancel that is not followed by a re-add still releases the id at the end
+    BookMutation cancel[] = {{a, JournalOp::Remove, Side::Bid, 0, Price(), 0}};
+    EXPECT_EQ(book.apply_batch(cancel, 1, fills), 1u);
+    EXPECT_EQ(book.find_handle("A"), kInvalidHandle);
+}
+
+// -----------------------------------------------------------------------------
+// BOOK MANAGER
+// -----------------------------------------------------------------------------
+// A small ring forces many wrap-arounds and full/empty transitions
+TEST(SpscRingTest, DeliversEverythingInOrderAcrossThreads) {
+    SpscRing<uint64_t> ring(8);
+    EXPECT_EQ(ring.capacity(), 8u);
+    constexpr uint64_t kCount = 200000;
+    thread producer([&] {
+        uint64_t buf[5];
+        for (uint64_t next = 0; next < kCount;) {
+            size_t n = min<uint64_t>(5, kCount - next);
+            for (size_t i = 0; i < n; ++i) buf[i] = next + i;
+            size_t pushed = ring.try_push(buf, n);
+            if (!pushed) this_thread::yield(); // full: let the consumer run
+            next += pushed;
+        }
+    });
+    uint64_t expect = 0;
+    bool in_order = true;
+    while (expect < kCount) {
+        size_t got = ring.drain([&](const uint64_t *v, size_t n) {
+            for (size_t i = 0; i < n; ++i) in_order &= v[i] == expect++;
+        }, 3);
+        if (!got) this_thread::yield(); // empty: let the producer run
+    }
+    producer.join();
+    EXPECT_TRUE(in_order);
+    EXPECT_TRUE(ring.empty());
+}
+
+TEST(BookManagerTest, RoutesBySymbolAcrossWorkers) {
+    BookManager<LadderOrderBook> mgr(3);
+    vector<SymbolId> syms;
+    for (int i = 0; i < 8; ++i) syms.push_back(mgr.add_symbol(0.01));
+    EXPECT_EQ(mgr.worker_of(syms[0]), 0);
+    EXPECT_EQ(mgr.worker_of(syms[4]), 1);
+
+    atomic<int> fills_seen{0};
+    mgr.on_fills([&](SymbolId, const vector<Fill> &f) { fills_seen += int(f.size()); });
+    mgr.start();
+
+    // the same flow on every symbol (shifted by a symbol-specific price) and on a
+    // single-threaded reference book
+    LadderOrderBook ref(0.01);
+    vector<Fill> ref_fills;
+    int ref_fill_count = 0;
+    for (int i = 0; i < 200; ++i) {
+        double px = 10 + (i % 10) / 100.0;
+        ref.add_order("b" + to_string(i), Side::Bid, px, 10);
+        if (i % 4 == 3) ref.remove_order("b" + to_string(i - 1));
+        if (i % 5 == 4) ref.amend_order("b" + to_string(i), nullopt, 5);
+        for (SymbolId s : syms) {
+            mgr.add_order(s, "b" + to_string(i), Side::Bid, px + s, 10);
+            if (i % 4 == 3) mgr.remove_order(s, "b" + to_string(i - 1));
+            if (i % 5 == 4) mgr.amend_order(s, "b" + to_string(i), nullopt, 5);
+        }
+    }
+    ref.add_and_match("sweep", Side::Ask, 10.05, 55, ref_fills);
+    ref_fill_count = int(ref_fills.size());
+    for (SymbolId s : syms) mgr.add_and_match(s, "sweep", Side::Ask, 10.05 + s, 55);
+    EXPECT_FALSE(mgr.add_order(SymbolId(99), "x", Side::Bid, 1, 1)); // unknown symbol
+    EXPECT_FALSE(mgr.add_order(syms[0], string(kJournalMaxId + 1, 'x'), Side::Bid, 1, 1));
+    mgr.sync();
+
+    EXPECT_EQ(fills_seen, ref_fill_count * int(syms.size()));
+    EXPECT_EQ(mgr.stats().rejected, 0);
+    for (SymbolId s : syms) {
+        auto &b = mgr.book(s);
+        EXPECT_EQ(b.num_orders_on_side(Side::Bid), ref.num_orders_on_side(Side::Bid));
+        EXPECT_EQ(b.quantity_on_side(Side::Bid), ref.quantity_on_side(Side::Bid));
+        EXPECT_EQ(b.top_price(Side::Bid)->units, ref.top_price(Side::Bid)->units + Price(double(s)).units);
+        EXPECT_GT(b.get_order("b0").value()->creation_time, TimePoint()); // stamped by the worker's book
+    }
+    mgr.stop();
+}
+
+// -----------------------------------------------------------------------------
+// LADDER BACKEND
+// -----------------------------------------------------------------------------
+TEST(LadderOrderBookTest, LevelsFollowPriceAcrossReanchoring) {
+    LadderOrderBook lb(0.01);
+    lb.add_order("A", Side::Bid, 50.00, 10);
+    lb.add_order("B", Side::Bid, 49.99, 10);
+    lb.add_order("C", Side::Bid, 120.00, 10); // far outside the initial window
+    lb.add_order("D", Side::Bid, 10.00, 10);
+
+    auto prices = lb.price_levels(Side::Bid);
+    ASSERT_EQ(prices.size(), 4);
+    EXPECT_EQ(prices[0], 120.00);
+    EXPECT_EQ(prices[1], 50.00);
+    EXPECT_EQ(prices[2], 49.99);
+    EXPECT_EQ(prices[3], 10.00);
+
+    lb.remove_order("C");
+    EXPECT_EQ(lb.top_price(Side::Bid), 50.00);
+    lb.remove_order("D");
+    EXPECT_EQ(lb.bottom_price(Side::Bid), 49.99);
+    EXPECT_EQ(lb.num_orders_at(Side::Bid, 50.00), 1);
+}
+
+TEST(LadderOrderBookTest, PricesBeyondTheMaxSpanAreRejected) {
+    LadderOrderBook lb(0.01);
+    const double span = double(PriceLadder<PriceLevel, DescPrice>::kMaxSpanTicks) / 100;
+    ASSERT_TRUE(lb.add_order("A", Side::Bid, 1.00, 10));
+    EXPECT_FALSE(lb.add_order("far", Side::Bid, 50000000.00, 10)); // fat finger: no huge array
+    EXPECT_TRUE(lb.add_order("B", Side::Bid, 1.00 + span - 0.01, 10)); // last tick in range
+    EXPECT_FALSE(lb.add_order("C", Side::Bid, 1.00 + span, 10));
+    EXPECT_FALSE(lb.amend_order("A", 1.00 + 2 * span, nullopt));
+    vector<Fill> fills;
+    EXPECT_FALSE(lb.add_and_match("D", Side::Bid, 50000000.00, 10, fills).accepted);
+    EXPECT_TRUE(lb.add_order("E", Side::Ask, 50000000.00, 10)); // each side has its own span
+    EXPECT_EQ(lb.num_orders_on_side(Side::Bid), 2);
+
+    OrderBook mb(0.01); // the map backend has no span limit
+    EXPECT_TRUE(mb.add_order("A", Side::Bid, 1.00, 10));
+    EXPECT_TRUE(mb.add_order("far", Side::Bid, 50000000.00, 10));
+}
+
+// Orders keep a pointer to their level; re-anchoring must not move the levels
+TEST(LadderOrderBookTest, CancelAndAmendAfterReanchoringUseStableLevels) {
+    LadderOrderBook lb(0.01);
+    lb.add_order("A", Side::Ask, 50.00, 100);
+    lb.add_order("B", Side::Ask, 50.00, 100);
+    lb.add_order("C", Side::Ask, 500.00, 10); // grows and re-anchors the array
+    lb.add_order("D", Side::Ask, 1.00, 10);
+
+    EXPECT_TRUE(lb.amend_order("A", nullopt, 40)); // qty down in place
+    EXPECT_TRUE(lb.amend_order("B", nullopt, 150)); // qty up, back of the queue
+    EXPECT_EQ(lb.quantity_at(Side::Ask, 50.00), 190);
+
+    EXPECT_TRUE(lb.remove_order("A"));
+    EXPECT_TRUE(lb.remove_order("B"));
+    EXPECT_EQ(lb.num_price_levels(Side::Ask), 2);
+    EXPECT_EQ(lb.quantity_on_side(Side::Ask), 20);
+
+    EXPECT_TRUE(lb.amend_order("D", 500.00, nullopt)); // joins C's level, drops its own
+    EXPECT_EQ(lb.num_price_levels(Side::Ask), 1);
+    EXPECT_EQ(lb.num_orders_at(Side::Ask, 500.00), 2);
+}
+
+// Drive both backends with the same random flow and compare every query
+TEST(LadderOrderBookTest, MatchesMapBackendOnRandomFlow) {
+    OrderBook mb;
+    LadderOrderBook lb(0.01);
+    mt19937 rng(42);
+    vector<string> live;
+    vector<Fill> mf, lf;
+
+    for (int i = 0; i < 20000; ++i) {
+        int op = rng() % 10;
+        double price = (4900 + int(rng() % 200)) / 100.0;
+        uint64_t qty = 1 + rng() % 100;
+        Side side = (rng() & 1) ? Side::Bid : Side::Ask;
+
+        if (op < 4 || live.empty()) {
+            string id = to_string(i);
+            mb.add_order(id, side, price, qty);
+            lb.add_order(id, side, price, qty);
+            live.push_back(id);
+        } else if (op < 7) {
+            size_t k = rng() % live.size();
+            EXPECT_EQ(mb.remove_order(live[k]), lb.remove_order(live[k]));
+            live[k] = live.back();
+            live.pop_back();
+        } else if (op < 9) {
+            const string &id = live[rng() % live.size()];
+            optional<double> np = (rng() & 1) ? optional<double>(price) : nullopt;
+            EXPECT_EQ(mb.amend_order(id, np, qty), lb.amend_order(id, np, qty));
+        } else {
+            string id = to_string(i);
+            auto mr = mb.add_and_match(id, side, price, qty, mf);
+            auto lr = lb.add_and_match(id, side, price, qty, lf);
+            EXPECT_EQ(mr.filled, lr.filled);
+            EXPECT_EQ(mf.size(), lf.size());
+            if (mr.resting) live.push_back(id);
+        }
+        // fully filled makers are gone from both books
+        live.erase(remove_if(live.begin(), live.end(),
+                             [&](const string &id) { return !mb.get_order(id); }),
+                   live.end());
+    }
+
+    for (Side s : {Side::Bid, Side::Ask}) {
+        ASSERT_EQ(mb.price_levels(s), lb.price_levels(s));
+        EXPECT_EQ(mb.top_price(s), lb.top_price(s));
+        EXPECT_EQ(mb.bottom_price(s), lb.bottom_price(s));
+        auto mo = mb.orders_on_side(s);
+        auto lo = lb.orders_on_side(s);
+        ASSERT_EQ(mo.size(), lo.size());
+
+        // cached aggregates agree with a full recount
+        uint64_t side_qty = 0;
+        for (auto &o : mo) side_qty += o->quantity;
+        EXPECT_EQ(mb.num_orders_on_side(s), mo.size());
+        EXPECT_EQ(mb.quantity_on_side(s), side_qty);
+        EXPECT_EQ(lb.quantity_on_side(s), side_qty);
+        for (Price p : mb.price_levels(s)) {
+            uint64_t level_qty = 0;
+            for (auto &o : mb.orders_at(s, p)) level_qty += o->quantity;
+            EXPECT_EQ(mb.quantity_at(s, p), level_qty);
+            EXPECT_EQ(lb.quantity_at(s, p), level_qty);
+        }
+        for (size_t i = 0; i < mo.size(); ++i) {
+            EXPECT_EQ(mo[i]->id, lo[i]->id);
+            EXPECT_EQ(mo[i]->quantity, lo[i]->quantity);
+        }
+    }
+}
+
+TEST(OccupancyBitmapTest, FindNextAndPrevMatchOrderedSet) {
+    OccupancyBitmap bm;
+    bm.assign(20000);
+    set<size_t> ref;
+    mt19937 rng(7);
+    for (int i = 0; i < 400; ++i)
+    {
+        size_t k = rng() % 20000;
+        if (ref.count(k)) { ref.erase(k); bm.reset(k); }
+        else { ref.insert(k); bm.set(k); }
+    }
+    for (size_t i = 0; i < 20000; i += 37)
+    {
+        auto nx = ref.lower_bound(i);
+        EXPECT_EQ(bm.find_next(i), nx == ref.end() ? OccupancyBitmap::npos : *nx);
+        auto pv = ref.upper_bound(i);
+        EXPECT_EQ(bm.find_prev(i), pv == ref.begin() ? OccupancyBitmap::npos : *prev(pv));
+    }
+
+    // sparse bits on the largest ladder array: gaps cross summary (4096-slot) and top
+    // (2^18-slot) words, and clearing a bit must clear the levels above it
+    const size_t n = size_t(1) << 22;
+    bm.assign(n);
+    ref = {3, 300000, n / 2, n - 1};
+    for (size_t k : ref) bm.set(k);
+    bm.set(n / 2 + 1);
+    bm.reset(n / 2 + 1);
+    for (size_t i : {size_t(0), size_t(4), size_t(299999), size_t(300001), n / 2 - 1, n / 2 + 1, n - 2, n - 1})
+    {
+        auto nx = ref.lower_bound(i);
+        EXPECT_EQ(bm.find_next(i), nx == ref.end() ? OccupancyBitmap::npos : *nx);
+        auto pv = ref.upper_bound(i);
+        EXPECT_EQ(bm.find_prev(i), pv == ref.begin() ? OccupancyBitmap::npos : *prev(pv));
+    }
+    bm.reset(n / 2);
+    EXPECT_EQ(bm.find_next(300001), n - 1);
+    EXPECT_EQ(bm.find_prev(n - 2), 300000u);
+    bm.reset(3);
+    EXPECT_EQ(bm.find_prev(299999), OccupancyBitmap::npos);
+}
+
+TEST(IdInternerTest, MatchesUnorderedMapUnderChurn) {
+    IdInterner ids;
+    unordered_map<string, OrderHandle> ref;
+    vector<string> live;
+    mt19937 rng(11);
+    for (int i = 0; i < 60000; ++i) { // grows from empty through several rehashes
+        if (live.empty() || rng() % 3) {
+            string id = "id" + to_string(rng() % 100000);
+            OrderHandle h = ids.intern(id);
+            auto [it, added] = ref.emplace(id, h);
+            EXPECT_EQ(it->second, h);
+            if (added) live.push_back(id);
+        } else { // release a random live id (backward-shift erase)
+            size_t k = rng() % live.size();
+            ids.release(ref[live[k]]);
+            ref.erase(live[k]);
+            live[k] = live.back();
+            live.pop_back();
+        }
+    }
+    for (auto &[id, h] : ref) {
+        EXPECT_EQ(ids.find(id), h);
+        EXPECT_EQ(ids.id(h), id);
+    }
+    for (int i = 100000; i < 101000; ++i) EXPECT_EQ(ids.find("id" + to_string(i)), kInvalidHandle);
+}
+
+// -----------------------------------------------------------------------------
+// LATENCY HISTOGRAMS
+// -----------------------------------------------------------------------------
+TEST(LatencyHistogramTest, PercentilesAreWithinBucketPrecision) {
+    LatencyHistogram h;
+    for (uint64_t v = 1; v <= 10000; ++v) h.record(v);
+
+    EXPECT_EQ(h.count(), 10000);
+    EXPECT_EQ(h.max(), 10000);
+    EXPECT_NEAR(double(h.percentile(0.50)), 5000, 5000 / 16.0);
+    EXPECT_NEAR(double(h.percentile(0.99)), 9900, 9900 / 16.0);
+    EXPECT_EQ(h.percentile(1.0), 10000);
+    EXPECT_EQ(h.percentile(0.0001), 1);
+}
+
+#ifdef OB_INSTRUMENT
+TEST_F(OrderBookTest, InstrumentedBookTimesEachAmendPath) {
+    ob.add_order("A", Side::Bid, 50, 100);
+    ob.amend_order("A", 51.0, nullopt);  // price
+    ob.amend_order("A", nullopt, 200);   // qty up
+    ob.amend_order("A", nullopt, 150);   // qty down
+    ob.amend_order("Z", nullopt, 150);   // unknown id
+    ob.top_price(Side::Bid);
+    ob.is_crossed();                     // nested top_price calls count once
+
+    EXPECT_EQ(ob.latency()[BookOp::Add].count(), 1);
+    EXPECT_EQ(ob.latency()[BookOp::AmendPrice].count(), 1);
+    EXPECT_EQ(ob.latency()[BookOp::AmendQtyUp].count(), 1);
+    EXPECT_EQ(ob.latency()[BookOp::AmendQtyDown].count(), 1);
+    EXPECT_EQ(ob.latency()[BookOp::Amend].count(), 1);
+    EXPECT_EQ(ob.latency()[BookOp::Query].count(), 2);
+}
+
+TEST_F(OrderBookTest, InstrumentedBatchIsOneBatchSampleEvenWithAmends) {
+    OrderHandle a = ob.intern("A"), b = ob.intern("B");
+    ob.add_order(a, Side::Bid, 50, 100);
+    ob.add_order(b, Side::Bid, 50, 100);
+    ob.reset_latency();
+    BookMutation pkt[] = {{a, JournalOp::Amend, Side::Bid, kJournalHasQty, Price(), 200}, // qty up
+                          {b, JournalOp::Amend, Side::Bid, kJournalHasPrice, Price(51), 0},
+                          {b, JournalOp::Remove, Side::Bid, 0, Price(), 0}};
+    vector<Fill> fills;
+    EXPECT_EQ(ob.apply_batch(pkt, 3, fills), 3u);
+
+    EXPECT_EQ(ob.latency()[BookOp::Batch].count(), 1);
+    EXPECT_EQ(ob.latency()[BookOp::AmendQtyUp].count(), 0);
+    EXPECT_EQ(ob.latency()[BookOp::AmendPrice].count(), 0);
+    EXPECT_EQ(ob.latency()[BookOp::Remove].count(), 0);
+}
+#endif